@@ -0,0 +1,51 @@
+#ifndef C8_AOT_H
+#define C8_AOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * Runtime support for ROMs recompiled ahead of time to C by c8_aot. Each basic block found by
+ * static analysis becomes a function that executes the whole block directly against the chip8 and
+ * leaves the pc at its successor. Whatever the compiler could not see is interpreted by cpu_step
+ * instead: addresses that do not start a compiled block, such as the targets of BNNN, and blocks
+ * whose code has been overwritten since the ROM was compiled.
+ */
+
+/* A compiled block covering [start, end). run returns false on a CPU exception, like cpu_step. */
+struct c8_aot_block
+{
+    uint16_t start;
+    uint16_t end;
+    bool (*run)(struct chip8 *c8);
+};
+
+struct c8_aot
+{
+    const struct c8_aot_block *blocks;
+    size_t block_count;
+
+    /* One more than the index of the block starting at, and the block holding, each address. */
+    uint16_t entry[C8_XO_MEM_SIZE];
+    uint16_t owner[C8_XO_MEM_SIZE];
+
+    /* Set when a block is invalidated, so a running block returns before its next instruction. */
+    bool stale;
+};
+
+/* Initialise compiled code from the table of blocks emitted by c8_aot. */
+void aot_init(struct c8_aot *aot, const struct c8_aot_block *blocks, size_t block_count);
+
+/*
+ * Execute the compiled block at the pc, or interpret a single instruction where there is none.
+ * Return false on a CPU exception.
+ */
+bool aot_step(struct chip8 *c8);
+
+/* Invalidate the block holding an address, called by c8_mem_write8 for every write. */
+void aot_write(struct c8_aot *aot, uint16_t addr);
+
+#endif /* C8_AOT_H */
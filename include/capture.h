@@ -0,0 +1,87 @@
+#ifndef C8_CAPTURE_H
+#define C8_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+#include "display.h"
+
+struct chip8;
+
+/* The number of frames that may be queued for the writer before further frames are dropped. */
+#define C8_CAPTURE_QUEUE_LEN    64
+
+/* The size, in bytes, of a serialised framebuffer covering every plane. */
+#define C8_CAPTURE_FRAME_SIZE   (C8_DISPLAY_PLANES * C8_HIRES_HEIGHT * C8_ROW_WORDS * 8)
+
+/* Capture frame flags. */
+#define C8_CAPTURE_HIRES        0x01
+
+/*
+ * A single captured frame. When produced by the emulator this holds the full framebuffer, when
+ * read back from a stream it holds the framebuffer reconstructed from all deltas read so far.
+ */
+struct c8_capture_frame
+{
+    uint32_t frame;
+    uint8_t timer_sound;
+    uint8_t flags;
+    uint64_t rows[C8_DISPLAY_PLANES][C8_HIRES_HEIGHT][C8_ROW_WORDS];
+};
+
+/*
+ * A gameplay capture stream. Frames are handed from the emulator to a background writer thread
+ * through a single-producer single-consumer ring, so the emulator never blocks on disk I/O. If the
+ * writer falls behind, frames are dropped rather than stalling emulation.
+ *
+ * The stream begins with the magic "C8CAP" and a version byte, followed by one record per changed
+ * frame: frame number (u32), sound timer (u8), flags (u8), payload length (u16), all little endian,
+ * then the payload. The payload is the XOR of the big-endian serialised framebuffer against the
+ * previous record, encoded as repeated (zero run, literal count, literal bytes) groups where both
+ * counts are LEB128 varints.
+ */
+struct c8_capture
+{
+    FILE *file;
+    SDL_Thread *writer;
+    SDL_sem *pending;
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t running;
+    SDL_atomic_t dropped;
+
+    /* Producer state, used to skip submitting frames that have not changed. */
+    bool sound_on;
+
+    /* Writer state, the last frame written to the stream. */
+    uint8_t previous[C8_CAPTURE_FRAME_SIZE];
+
+    struct c8_capture_frame queue[C8_CAPTURE_QUEUE_LEN];
+};
+
+/* Create a capture file and start its writer thread. Return true on success. */
+bool capture_open(struct c8_capture *capture, const char *filename);
+
+/*
+ * Submit the current state of a chip8 for capture as the given emulated frame. The frame is only
+ * recorded if the display changed (dirty) or the sound output was switched on or off.
+ */
+void capture_frame(struct c8_capture *capture, struct chip8 *c8, uint32_t frame, bool dirty);
+
+/* Flush all queued frames, stop the writer thread and close the file. */
+void capture_close(struct c8_capture *capture);
+
+/* Read and validate a capture stream header. Return true if the stream is a valid capture. */
+bool capture_read_header(FILE *file);
+
+/*
+ * Read the next record from a capture stream, applying its delta to the framebuffer held in
+ * frame. The frame should be zeroed before the first call. Return 1 if a record was read, 0 at the
+ * end of the stream, or -1 if the record is truncated or malformed or could not be read.
+ */
+int capture_read_frame(FILE *file, struct c8_capture_frame *frame);
+
+#endif /* C8_CAPTURE_H */
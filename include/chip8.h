@@ -7,26 +7,145 @@
 
 #include <SDL2/SDL.h>
 
+#include "capture.h"
 #include "cpu.h"
+#include "display.h"
+#include "metrics.h"
+#include "shared.h"
 
 #define C8_MEM_SIZE             0x1000
-#define C8_DISPLAY_WIDTH        64
-#define C8_DISPLAY_HEIGHT       32
+#define C8_XO_MEM_SIZE          0x10000
+
+/* Returned by c8_key_await when the wait is abandoned rather than ended by a key. */
+#define C8_KEY_NONE             0xFF
+
+/* The instruction set variants understood by the interpreter. */
+enum c8_mode
+{
+    C8_MODE_CHIP8,
+    C8_MODE_SCHIP,
+    C8_MODE_XOCHIP
+};
+
+/*
+ * How instructions are paced. Fixed timing executes C8_FPS instructions per second regardless of
+ * cost. VIP timing charges each instruction the machine cycles it takes on a COSMAC VIP and runs
+ * each 60 Hz frame until the cycle budget of a frame is spent.
+ */
+enum c8_timing
+{
+    C8_TIMING_FIXED,
+    C8_TIMING_VIP
+};
+
+struct c8_aot;
+struct c8_debugger;
+struct c8_snapshot;
+struct c8_watch;
 
 /* Global declarations. */
 extern const uint16_t C8_LOAD_ADDR;
 extern const size_t C8_SPRITE_LEN;
+extern const uint16_t C8_BIG_FONT_ADDR;
+extern const size_t C8_BIG_SPRITE_LEN;
 extern const char *C8_WINDOW_TITLE;
 extern const int C8_FPS;
 extern int KEYMAP[16]; 
 
+/* Startup phases timed for a startup report. */
+enum c8_phase
+{
+    C8_PHASE_INIT,
+    C8_PHASE_LOAD,
+    C8_PHASE_WINDOW,
+    C8_PHASE_FIRST_FRAME,
+    C8_PHASE_AUDIO,
+    C8_PHASE_COUNT
+};
+
+/*
+ * Per-phase startup timings in milliseconds. The caller records the phases it drives itself, the
+ * rest are filled in by the chip8, which prints the report once the first frame is presented.
+ */
+struct c8_startup
+{
+    Uint64 origin;
+    double phase_ms[C8_PHASE_COUNT];
+    bool reported;
+};
+
 /* Represents a CHIP-8 system, comprising of a CPU, memory, display and keyboard. */ 
 struct chip8
 {
     struct c8_cpu *cpu;
-    uint8_t memory[C8_MEM_SIZE];
-    uint8_t display[C8_DISPLAY_WIDTH * C8_DISPLAY_HEIGHT];
+    enum c8_mode mode;
+    enum c8_timing timing;
+
+    /* 
+     * The active address space. This points at core_memory unless XO-CHIP mode is enabled, in 
+     * which case it is grown to a 64 KB heap allocation.
+     */
+    uint8_t *memory;
+    size_t mem_size;
+    uint8_t core_memory[C8_MEM_SIZE];
+
+    struct c8_display display;
+
+    /* XO-CHIP audio pattern buffer and pitch register. */
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
+
     bool keyboard[16];
+
+    /* The number of frames emulated since the chip8 started running. */
+    uint32_t frame;
+
+    /* Optional gameplay capture stream, NULL when capture is disabled. Closed by c8_destroy. */
+    struct c8_capture *capture;
+
+    /*
+     * Optional ahead-of-time compiled code, NULL when interpreting. Set by the standalone binaries
+     * generated by c8_aot, which run whole basic blocks in place of cpu_step.
+     */
+    struct c8_aot *aot;
+
+    /* Optional interactive debugger, NULL when debugging is disabled. Closed by c8_destroy. */
+    struct c8_debugger *debugger;
+
+    /* Optional shared-memory state export, NULL when disabled. Closed by c8_destroy. */
+    struct c8_shared *shared;
+
+    /* Optional ROM hot reload, NULL when disabled. Closed by c8_destroy. */
+    struct c8_watch *watch;
+
+    /* Runtime counters and histograms, always updated. */
+    struct c8_metrics metrics;
+
+    /* Optional periodic metrics export, NULL when disabled. Closed by c8_destroy. */
+    struct c8_metrics_export *metrics_export;
+
+    /* Optional startup timings, NULL unless a startup report was requested. */
+    struct c8_startup *startup;
+
+    /*
+     * Optional run-ahead scratch state, NULL when disabled. Once per 60 Hz frame the next one is
+     * emulated speculatively with the current input and presented, then rolled back from this
+     * snapshot, hiding a frame of latency from games that react to input a frame late.
+     */
+    struct c8_snapshot *run_ahead;
+
+    /*
+     * Input latency tracking. A key press is timestamped when its event is queued, observed when
+     * the program first reads the key as pressed through EX9E, EXA1 or FX0A, and measured when the
+     * first frame rendered after that is presented. A press the program never reads is replaced by
+     * the next one.
+     */
+    Uint64 input_pending;
+    uint8_t input_key;
+    bool input_observed;
+    uint64_t input_draw_calls;
+    bool latency_report;
+
     bool alive;
     bool beep;
     bool draw;
@@ -38,6 +157,23 @@ struct chip8
  */
 bool c8_init(struct chip8 *c8, struct c8_cpu *cpu);
 
+/*
+ * Open the window of a chip8 instance. This must be called from the main thread before running
+ * the chip8, but is independent of loading, so a rom may be loaded on another thread meanwhile.
+ * Audio is opened later, when the sound timer is first set or expires.
+ */
+bool c8_open(struct chip8 *c8);
+
+/* Return the number of milliseconds elapsed since a performance counter value. */
+double c8_startup_ms(Uint64 since);
+
+/*
+ * Select the instruction set variant emulated by a chip8 instance. Selecting XO-CHIP grows the 
+ * address space to 64 KB. This should be called after c8_init and before loading a rom.
+ * Return true on success, false if memory could not be allocated.
+ */
+bool c8_set_mode(struct chip8 *c8, enum c8_mode mode);
+
 /* 
  * Load a rom file into the CHIP-8 at a given address. 
  * Return the number of bytes loaded, or -1 in the case of an error . 
@@ -72,7 +208,11 @@ void c8_mem_write8(struct chip8 *c8, uint16_t addr, uint8_t value);
 /* Check if a key is currently pressed. Return true if the key is pressed, false otherwise. */
 bool c8_key_pressed(struct chip8 *c8, uint8_t key);
 
-/* Wait for a key to be pressed, and return the key that was pressed. */
+/*
+ * Wait for a key to be pressed, and return the key that was pressed. Return C8_KEY_NONE instead if
+ * the chip8 is stopped or a ROM reload is pending while waiting, in which case FX0A leaves the pc
+ * on itself, to wait again once the run loop has handled it.
+ */
 uint8_t c8_key_await(struct chip8 *c8);
 
 /* Emit a beep sound from a chip8 machine. */
@@ -11,6 +11,15 @@ struct chip8;
 /* The size, in bytes, of a CHIP-8 CPU instruction. */
 extern const size_t C8_INS_LEN;
 
+/*
+ * COSMAC VIP machine cycles (8 clocks of the 1.7609 MHz CDP1802) per 60 Hz frame, and the share of
+ * each frame taken by the display interrupt and its 128 lines of 8 byte DMA. The remainder is
+ * the budget available to the interpreter.
+ */
+#define C8_VIP_CYCLES_PER_FRAME 3668
+#define C8_VIP_DISPLAY_CYCLES   1070
+#define C8_VIP_FRAME_CYCLES     (C8_VIP_CYCLES_PER_FRAME - C8_VIP_DISPLAY_CYCLES)
+
 /*
  * Represents a CHIP-8 processor capable of fetch, decode and execute of 
  * the CHIP-8 instruction set.
@@ -31,6 +40,18 @@ struct c8_cpu
 
     /* A stack for local variables and call handling. */
     uint16_t stack[0x10];
+
+    /* SUPER-CHIP/XO-CHIP persistent user flags, saved and restored by FX75/FX85. */
+    uint8_t rpl[0x10];
+
+    /*
+     * Cycles spent in the current frame. Each instruction adds its cost, one under fixed timing or
+     * its VIP machine cycles under VIP timing, and the run loop deducts the budget of each frame.
+     */
+    uint32_t cycles;
+
+    /* The xorshift state behind 0xCXNN, held per machine so snapshots also restore it. */
+    uint32_t rng;
 };
 
 /*
@@ -43,8 +64,11 @@ struct c8_cpu
  * I: 0
  * V0-vF: 0
  * Stack: Empty
+ * RPL flags: 0
  * Delay timer: 0
  * Sound timer: 0
+ * Cycles: 0
+ * RNG: seeded from the clock
  */
 void cpu_init(struct c8_cpu *cpu);
 
@@ -54,4 +78,22 @@ void cpu_init(struct c8_cpu *cpu);
  */
 bool cpu_step(struct chip8 *c8);
 
+/*
+ * Charge the cost of an instruction to the cycles of the current frame, before it is executed.
+ * cpu_step does this itself, it is exposed for code recompiled ahead of time by c8_aot.
+ */
+void cpu_clock(struct chip8 *c8, uint16_t op);
+
+/* Return the next random byte for 0xCXNN, advancing the CPU's generator. */
+uint8_t cpu_random(struct c8_cpu *cpu);
+
+/* Draw a sprite from memory at I for 0xDXYN, setting VF on collision. */
+void cpu_draw_sprite(struct chip8 *c8, uint8_t x, uint8_t y, uint8_t height);
+
+/*
+ * Decrement the delay and sound timers, raising the beep flag when the sound timer expires. Under
+ * fixed timing this is done by every step, under VIP timing the run loop calls it once per frame.
+ */
+void cpu_decrement_timers(struct chip8 *c8);
+
 #endif /* C8_CPU_H */
@@ -0,0 +1,60 @@
+#ifndef C8_DEBUG_H
+#define C8_DEBUG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/* Per-address debugger flags. */
+#define C8_DEBUG_BREAK          0x01
+#define C8_DEBUG_WATCH          0x02
+
+/*
+ * An interactive debugger attached to a chip8 instance. Breakpoints and watchpoints are stored as
+ * flags in a side table indexed by address, which is only consulted by the debug variant of the
+ * interpreter loop and by c8_mem_write8, so a chip8 without a debugger attached pays nothing.
+ *
+ * The debugger is driven either from a console prompt on stdin, or by a client speaking the GDB
+ * remote serial protocol over a TCP socket bound to the loopback interface. The remote register
+ * layout is V0-VF, I (16-bit), PC (16-bit), SP, DT, ST with multi-byte values in little endian.
+ */
+struct c8_debugger
+{
+    uint8_t flags[C8_XO_MEM_SIZE];
+
+    /* True if execution should stop before the next instruction. */
+    bool stop;
+
+    /* The number of instructions left to execute before stopping when single stepping. */
+    int steps;
+
+    /* The address of the last watchpoint triggered, valid while watch_hit is set. */
+    bool watch_hit;
+    uint16_t watch_addr;
+
+    /* Remote stub sockets, -1 when the console is in use. */
+    int listen_fd;
+    int client_fd;
+};
+
+/*
+ * Initialise a debugger, stopped before the first instruction. If port is non-zero, wait for a
+ * remote client to connect to that port, otherwise use the console. Return true on success.
+ */
+bool debug_init(struct c8_debugger *debugger, int port);
+
+/* Close any sockets held by a debugger. */
+void debug_destroy(struct c8_debugger *debugger);
+
+/*
+ * Called by the debug interpreter when a breakpoint, watchpoint or single step stops execution
+ * before the instruction at PC. Runs a command session until execution is resumed. Return false if
+ * the user asked to terminate the chip8.
+ */
+bool debug_break(struct chip8 *c8);
+
+/* Called by c8_mem_write8 for every write while a debugger is attached. */
+void debug_watch(struct chip8 *c8, uint16_t addr);
+
+#endif /* C8_DEBUG_H */
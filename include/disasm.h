@@ -0,0 +1,101 @@
+#ifndef C8_DISASM_H
+#define C8_DISASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+/* How an instruction affects control flow. */
+enum c8_flow
+{
+    C8_FLOW_NEXT,       /* continues at the following instruction */
+    C8_FLOW_JUMP,       /* 1NNN, continues at target */
+    C8_FLOW_CALL,       /* 2NNN/0NNN, continues at target then returns to the next instruction */
+    C8_FLOW_RET,        /* 00EE */
+    C8_FLOW_SKIP,       /* conditionally skips the following instruction */
+    C8_FLOW_INDIRECT,   /* BNNN, the target depends on a register */
+    C8_FLOW_HALT        /* 00FD or an illegal opcode */
+};
+
+/* A decoded instruction. */
+struct c8_ins
+{
+    uint16_t op;
+    uint8_t len;
+    enum c8_flow flow;
+
+    /* Branch target for jumps and calls, or the address loaded into I when loads_i is set. */
+    uint16_t target;
+    bool loads_i;
+};
+
+/* Address map flags produced by disasm_trace. */
+#define C8_MAP_CODE             0x01    /* first byte of a reachable instruction */
+#define C8_MAP_OPERAND          0x02    /* trailing byte of a reachable instruction */
+#define C8_MAP_BLOCK            0x04    /* first instruction of a basic block */
+#define C8_MAP_DATA_REF         0x08    /* address loaded into I, typically sprite data */
+
+/* A basic block, a run of instructions entered only at the top and left only at the bottom. */
+struct c8_block
+{
+    uint16_t start;
+    uint16_t end;           /* address following the last instruction */
+    enum c8_flow exit;      /* flow of the last instruction */
+
+    /* Successors within the program, in the order fall through/skip target or jump target. */
+    uint16_t succ[2];
+    int succ_count;
+
+    /* Called subroutine for blocks ending in a call. */
+    uint16_t call;
+
+    /* True if the block only ever transfers control back to itself, e.g. a halting JP. */
+    bool idle;
+};
+
+/*
+ * A statically analysed ROM. Code is discovered by tracing every path reachable from the load
+ * address through jumps, calls and skips; anything in the ROM that is never reached is data.
+ * Computed jumps (BNNN) cannot be followed, so code only reachable through them is reported as data.
+ */
+struct c8_program
+{
+    enum c8_mode mode;
+    uint8_t memory[C8_XO_MEM_SIZE];
+    uint8_t map[C8_XO_MEM_SIZE];
+
+    /* The ROM occupies [C8_LOAD_ADDR, end). */
+    uint32_t end;
+
+    struct c8_block *blocks;
+    size_t block_count;
+};
+
+/*
+ * Format a single instruction as assembly text, decoding the same opcode space as cpu_step for
+ * the given mode. The word following the instruction is required to decode the 4 byte XO-CHIP
+ * 0xF000 NNNN instruction. Return the length of the instruction in bytes.
+ */
+int disasm_format(uint16_t op, uint16_t next, enum c8_mode mode, char *buf, size_t len);
+
+/* Decode the control flow of a single instruction, with the same arguments as disasm_format. */
+void disasm_decode(uint16_t op, uint16_t next, enum c8_mode mode, struct c8_ins *ins);
+
+/* Initialise a program from a ROM image loaded at C8_LOAD_ADDR. Return false if it is too large. */
+bool disasm_load(struct c8_program *program, const uint8_t *rom, size_t len, enum c8_mode mode);
+
+/* Trace reachable code and build the basic blocks of a program. Return false if out of memory. */
+bool disasm_trace(struct c8_program *program);
+
+/* Release the blocks held by a traced program. */
+void disasm_free(struct c8_program *program);
+
+/* Write a program listing, with code grouped into labelled blocks and data emitted as bytes. */
+void disasm_print(const struct c8_program *program, FILE *out);
+
+/* Write the control flow graph of a program in Graphviz dot format. */
+void disasm_print_dot(const struct c8_program *program, FILE *out);
+
+#endif /* C8_DISASM_H */
@@ -0,0 +1,69 @@
+#ifndef C8_DISPLAY_H
+#define C8_DISPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define C8_DISPLAY_WIDTH        64
+#define C8_DISPLAY_HEIGHT       32
+#define C8_HIRES_WIDTH          128
+#define C8_HIRES_HEIGHT         64
+#define C8_DISPLAY_PLANES       2
+#define C8_ROW_WORDS            (C8_HIRES_WIDTH / 64)
+
+/*
+ * Represents the CHIP-8 framebuffer. Each plane holds one bit per pixel, packed into 128-bit rows
+ * of two 64-bit words with the leftmost pixel in the most significant bit of the first word. In
+ * lores mode only the first 32 rows and the first word of each row are in use, so the logical
+ * coordinate system always matches the current resolution.
+ *
+ * CHIP-8 and SUPER-CHIP only ever draw to plane 0. XO-CHIP selects any combination of both planes,
+ * and the colour of a pixel is the 2-bit index formed from the plane bits.
+ */
+struct c8_display
+{
+    uint64_t rows[C8_DISPLAY_PLANES][C8_HIRES_HEIGHT][C8_ROW_WORDS];
+
+    /* True when the display is in 128x64 mode. */
+    bool hires;
+
+    /* Bitmask of the planes affected by draw, clear and scroll operations. */
+    uint8_t planes;
+};
+
+/* Initialise a display in lores mode with all pixels cleared and plane 0 selected. */
+void display_init(struct c8_display *display);
+
+/* Return the logical width of the display in its current mode. */
+int display_width(const struct c8_display *display);
+
+/* Return the logical height of the display in its current mode. */
+int display_height(const struct c8_display *display);
+
+/* Switch between lores and hires mode. The display is cleared as part of the switch. */
+void display_set_hires(struct c8_display *display, bool hires);
+
+/* Clear all pixels on the selected planes. */
+void display_clear(struct c8_display *display);
+
+/*
+ * XOR a sprite onto a single plane with its top-left corner at (x, y). The starting coordinate
+ * wraps around the display, while any pixels falling off the right or bottom edge are clipped.
+ * Sprites are either 8 pixels wide (one byte per row) or 16 pixels wide (two bytes per row).
+ * Return true if any set pixel was cleared by the draw.
+ */
+bool display_draw(struct c8_display *display, int plane, int x, int y,
+        const uint8_t *sprite, int rows, bool wide);
+
+/* Scroll the selected planes down/up by n rows, filling vacated rows with blank pixels. */
+void display_scroll_down(struct c8_display *display, int n);
+void display_scroll_up(struct c8_display *display, int n);
+
+/* Scroll the selected planes left/right by 4 pixels, filling vacated columns with blank pixels. */
+void display_scroll_left(struct c8_display *display);
+void display_scroll_right(struct c8_display *display);
+
+/* Return the colour index (0-3) of the pixel at (x, y), formed from the bit of each plane. */
+uint8_t display_pixel(const struct c8_display *display, int x, int y);
+
+#endif /* C8_DISPLAY_H */
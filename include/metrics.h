@@ -0,0 +1,106 @@
+#ifndef C8_METRICS_H
+#define C8_METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+/*
+ * Log-linear histogram buckets. Values below 2^C8_HIST_SUB_BITS are recorded exactly, larger
+ * values keep C8_HIST_SUB_BITS bits of precision (about 6%), in the style of an HDR histogram.
+ */
+#define C8_HIST_SUB_BITS        4
+#define C8_HIST_SUB_COUNT       (1 << C8_HIST_SUB_BITS)
+#define C8_HIST_BUCKETS         ((32 - C8_HIST_SUB_BITS + 1) * C8_HIST_SUB_COUNT)
+
+/* A latency histogram, with values recorded in microseconds. */
+struct c8_histogram
+{
+    uint32_t buckets[C8_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint32_t max;
+};
+
+/* The latency histograms kept by a chip8. */
+enum c8_hist_id
+{
+    C8_HIST_FRAME,              /* time spent in an iteration of the run loop, excluding pacing */
+    C8_HIST_DRAW,               /* rendering the framebuffer into the back buffer */
+    C8_HIST_AUDIO,              /* time blocked playing a beep */
+    C8_HIST_INPUT,              /* time blocked waiting for a key press */
+    C8_HIST_LATENCY,            /* from a key press to the first present after it is read */
+    C8_HIST_COUNT
+};
+
+/*
+ * Runtime counters and histograms. These are embedded in every chip8 and always updated, as a
+ * counter increment is cheaper than checking whether anyone is listening.
+ */
+struct c8_metrics
+{
+    uint64_t instructions;
+    uint64_t frames;
+    uint64_t draw_calls;
+    uint64_t overruns;
+    uint64_t audio_blocked_us;
+    uint64_t input_blocked_us;
+    struct c8_histogram hist[C8_HIST_COUNT];
+};
+
+/*
+ * Periodic export of metrics in Prometheus text format, either rewritten to a file or served to
+ * each client connecting to a Unix socket. The emulator thread renders a snapshot once per
+ * interval, which a background thread hands out to socket clients under a lock.
+ */
+struct c8_metrics_export
+{
+    const char *file;
+    Uint32 interval_ms;
+    Uint32 next_dump;
+
+    /* State of the previous snapshot, used to derive rates. */
+    Uint32 last_dump;
+    uint64_t last_instructions;
+
+    SDL_mutex *lock;
+    char snapshot[8192];
+
+    /* The socket, and the path it is bound to, removed again on close. */
+    const char *socket_path;
+    int listen_fd;
+    SDL_Thread *server;
+    SDL_atomic_t running;
+};
+
+/* Reset all counters and histograms. */
+void metrics_init(struct c8_metrics *metrics);
+
+/* Record a value, in microseconds, in a histogram. */
+void metrics_record(struct c8_histogram *hist, uint32_t value);
+
+/* Return the approximate value at a quantile (0-1) of a histogram. */
+uint32_t metrics_percentile(const struct c8_histogram *hist, double quantile);
+
+/* Return the microseconds elapsed since a performance counter value. */
+uint32_t metrics_elapsed_us(Uint64 since);
+
+/* Write all metrics in Prometheus text format, return the number of characters written. */
+int metrics_format(const struct c8_metrics *metrics, double ips, char *buf, size_t len);
+
+/*
+ * Start exporting metrics every interval_ms, to a file and/or a Unix socket. Either path may be
+ * NULL. Return true on success.
+ */
+bool metrics_export_open(struct c8_metrics_export *exporter, const char *file, const char *socket_path,
+        Uint32 interval_ms);
+
+/* Called once per frame, writes a new snapshot when the export interval has elapsed. */
+void metrics_export_tick(struct c8_metrics_export *exporter, const struct c8_metrics *metrics);
+
+/* Write a final snapshot, stop the socket server and remove its socket. */
+void metrics_export_close(struct c8_metrics_export *exporter, const struct c8_metrics *metrics);
+
+#endif /* C8_METRICS_H */
@@ -0,0 +1,85 @@
+#ifndef C8_SHARED_H
+#define C8_SHARED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "display.h"
+
+struct chip8;
+
+/* The segment magic, "C8SH" in little endian, and the version of the layout below. */
+#define C8_SHARED_MAGIC         0x48533843
+#define C8_SHARED_VERSION       1
+
+/*
+ * The layout of a shared-memory state export, mapped directly by readers. All fields are in host
+ * byte order, and the framebuffer has the same layout as struct c8_display.
+ *
+ * The emulator publishes the state once per frame under a seqlock, and once more on entering
+ * FX0A, as no frames complete while it waits for a key: sequence is odd while a frame is being
+ * written. A reader copies what it needs between two reads of an even, unchanged sequence, with
+ * acquire barriers after the first read and before the second, and retries otherwise. Readers
+ * never block the emulator.
+ *
+ * Clients may drive the keyboard by writing keys (non-zero for pressed) and then incrementing
+ * key_sequence. The emulator applies the keys once per frame, and continuously while FX0A waits,
+ * whenever key_sequence has changed, so the real keyboard keeps working while no client is
+ * writing.
+ */
+struct c8_shared_segment
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+
+    /* Published by the emulator, guarded by sequence. */
+    SDL_atomic_t sequence;
+    uint32_t frame;
+    uint8_t mode;
+    uint8_t hires;
+    uint8_t planes;
+    uint8_t sp;
+    uint8_t v[0x10];
+    uint16_t i;
+    uint16_t pc;
+    uint16_t stack[0x10];
+    uint8_t timer_delay;
+    uint8_t timer_sound;
+    uint8_t keyboard[16];
+    uint64_t rows[C8_DISPLAY_PLANES][C8_HIRES_HEIGHT][C8_ROW_WORDS];
+
+    /* Written by clients. */
+    SDL_atomic_t key_sequence;
+    uint8_t keys[16];
+};
+
+/* A shared-memory state export, owned by the emulator. */
+struct c8_shared
+{
+    char name[256];
+    struct c8_shared_segment *segment;
+    int key_sequence;
+};
+
+/*
+ * Create a POSIX shared-memory segment with the given name, such as "/c8", and map it. Return true
+ * on success. An existing segment of the same name is replaced.
+ */
+bool shared_open(struct c8_shared *shared, const char *name);
+
+/*
+ * Apply any key state written by a client since the last call, called before each frame and while
+ * FX0A waits.
+ */
+void shared_input(struct c8_shared *shared, struct chip8 *c8);
+
+/* Publish the state of a chip8 as the given frame, called once each frame has run. */
+void shared_publish(struct c8_shared *shared, struct chip8 *c8, uint32_t frame);
+
+/* Unmap and remove the segment. */
+void shared_close(struct c8_shared *shared);
+
+#endif /* C8_SHARED_H */
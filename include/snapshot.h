@@ -0,0 +1,46 @@
+#ifndef C8_SNAPSHOT_H
+#define C8_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "display.h"
+
+/*
+ * A copy of the emulated machine state: processor, memory, display and the flags raised by the
+ * last instruction. Host state such as the window, keyboard and attached capture or debugger is
+ * not part of a snapshot, so restoring one rewinds the program without disturbing the session.
+ */
+struct c8_snapshot
+{
+    struct c8_cpu cpu;
+    struct c8_display display;
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
+    bool beep;
+    bool draw;
+    size_t mem_size;
+    uint8_t memory[C8_XO_MEM_SIZE];
+};
+
+/* Save the state of a chip8 into a snapshot. */
+void snapshot_save(struct chip8 *c8, struct c8_snapshot *snapshot);
+
+/*
+ * Restore the state of a chip8 from a snapshot. Return false, leaving the chip8 untouched, if the
+ * snapshot was taken with a different address space size.
+ */
+bool snapshot_restore(struct chip8 *c8, const struct c8_snapshot *snapshot);
+
+/*
+ * Write a snapshot to a file, or read one back. The file is a raw copy of the structure in host
+ * byte order behind a magic number and size check, so it is only portable between builds of the
+ * same emulator on the same platform. Return true on success.
+ */
+bool snapshot_write(const struct c8_snapshot *snapshot, const char *path);
+bool snapshot_read(struct c8_snapshot *snapshot, const char *path);
+
+#endif /* C8_SNAPSHOT_H */
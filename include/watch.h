@@ -0,0 +1,69 @@
+#ifndef C8_WATCH_H
+#define C8_WATCH_H
+
+#include <stdbool.h>
+
+#include <SDL2/SDL.h>
+
+#include "chip8.h"
+#include "snapshot.h"
+
+/* The state a reloaded ROM resumes from. */
+enum c8_watch_restore
+{
+    C8_RESTORE_RESET,           /* a fresh machine, starting at the load address */
+    C8_RESTORE_STATE,           /* the registers, stack, timers and display before the reload */
+    C8_RESTORE_SNAPSHOT         /* the registers, stack, timers and display of a snapshot file */
+};
+
+/*
+ * Hot reload of a ROM under development. A background thread blocks on inotify events for the
+ * directory holding the ROM, so rewrites and atomic renames are both seen, and posts an SDL event
+ * once the file changes. The run loop receives it along with its input and reloads the ROM before
+ * its next batch, into a cleared program area without reopening the window, so watching costs
+ * nothing between changes. A FX0A waiting for a key is abandoned so the reload is not held up.
+ */
+struct c8_watch
+{
+    char *rom;
+    char dir[4096];
+    const char *name;
+    enum c8_watch_restore restore;
+
+    /* Saved with F5 and restored on each reload under C8_RESTORE_SNAPSHOT. */
+    const char *snapshot_file;
+
+    /* The SDL event type posted on a change, and whether one is already queued. */
+    Uint32 event;
+    SDL_atomic_t pending;
+
+    /* Set once the event is received, the run loop reloads between batches of instructions. */
+    bool reload;
+
+    int fd;
+    int wd;
+    SDL_Thread *thread;
+    SDL_atomic_t running;
+
+    /* The state before a reload, restored if the new ROM fails to load. */
+    struct c8_snapshot previous;
+    struct c8_snapshot saved;
+};
+
+/*
+ * Start watching a ROM. snapshot_file is only used, and must be given, under C8_RESTORE_SNAPSHOT.
+ * Return true on success.
+ */
+bool watch_open(struct c8_watch *watch, char *rom, enum c8_watch_restore restore,
+        const char *snapshot_file);
+
+/* Reload the ROM into a chip8, called by the run loop between batches once reload is set. */
+void watch_reload(struct c8_watch *watch, struct chip8 *c8);
+
+/* Save the state of a chip8 to the snapshot file, when restoring from one. */
+void watch_save(struct c8_watch *watch, struct chip8 *c8);
+
+/* Stop watching, and wait for the watcher thread to exit. */
+void watch_close(struct c8_watch *watch);
+
+#endif /* C8_WATCH_H */
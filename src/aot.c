@@ -0,0 +1,52 @@
+#include <string.h>
+
+#include "aot.h"
+#include "cpu.h"
+
+void aot_init(struct c8_aot *aot, const struct c8_aot_block *blocks, size_t block_count)
+{
+    aot->blocks = blocks;
+    aot->block_count = block_count;
+    aot->stale = false;
+    memset(aot->entry, 0, sizeof aot->entry);
+    memset(aot->owner, 0, sizeof aot->owner);
+    for (size_t b = 0; b < block_count; b++)
+    {
+        aot->entry[blocks[b].start] = b + 1;
+        for (uint32_t addr = blocks[b].start; addr < blocks[b].end; addr++)
+        {
+            aot->owner[addr] = b + 1;
+        }
+    }
+}
+
+bool aot_step(struct chip8 *c8)
+{
+    struct c8_aot *aot = c8->aot;
+    const uint16_t ENTRY = aot->entry[c8->cpu->pc];
+    if (ENTRY == 0)
+    {
+        c8->metrics.instructions++;
+        return cpu_step(c8);
+    }
+    aot->stale = false;
+    return aot->blocks[ENTRY - 1].run(c8);
+}
+
+void aot_write(struct c8_aot *aot, uint16_t addr)
+{
+    const uint16_t OWNER = aot->owner[addr];
+    if (OWNER == 0)
+    {
+        return;
+    }
+
+    /* Self-modified code is interpreted from then on, even if the original bytes are restored. */
+    const struct c8_aot_block *block = &aot->blocks[OWNER - 1];
+    aot->entry[block->start] = 0;
+    for (uint32_t a = block->start; a < block->end; a++)
+    {
+        aot->owner[a] = 0;
+    }
+    aot->stale = true;
+}
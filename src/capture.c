@@ -0,0 +1,316 @@
+#include <string.h>
+
+#include "capture.h"
+#include "chip8.h"
+
+static const char CAPTURE_MAGIC[] = "C8CAP";
+static const uint8_t CAPTURE_VERSION = 1;
+
+/* Writer thread entry point. */
+static int capture_writer(void *data);
+
+/* Encode and write a single queued frame. */
+static bool capture_write(struct c8_capture *capture, const struct c8_capture_frame *frame);
+
+/* Convert between packed framebuffer rows and the big-endian serialised byte layout. */
+static void serialise(const uint64_t *words, uint8_t *bytes);
+static void deserialise(const uint8_t *bytes, uint64_t *words);
+
+/* LEB128 varint helpers, get_varint adds the bytes it reads to consumed. */
+static size_t put_varint(uint8_t *out, uint32_t value);
+static bool get_varint(FILE *file, uint32_t *value, size_t *consumed);
+
+bool capture_open(struct c8_capture *capture, const char *filename)
+{
+    capture->file = fopen(filename, "wb");
+    if (capture->file == NULL)
+    {
+        perror("Failed to open capture file");
+        return false;
+    }
+
+    fwrite(CAPTURE_MAGIC, 1, sizeof CAPTURE_MAGIC - 1, capture->file);
+    fputc(CAPTURE_VERSION, capture->file);
+
+    memset(capture->previous, 0, sizeof capture->previous);
+    capture->sound_on = false;
+    SDL_AtomicSet(&capture->head, 0);
+    SDL_AtomicSet(&capture->tail, 0);
+    SDL_AtomicSet(&capture->dropped, 0);
+    SDL_AtomicSet(&capture->running, 1);
+
+    capture->pending = SDL_CreateSemaphore(0);
+    if (capture->pending == NULL)
+    {
+        fprintf(stderr, "Failed to create capture semaphore: %s\n", SDL_GetError());
+        fclose(capture->file);
+        return false;
+    }
+
+    capture->writer = SDL_CreateThread(capture_writer, "c8_capture", capture);
+    if (capture->writer == NULL)
+    {
+        fprintf(stderr, "Failed to create capture thread: %s\n", SDL_GetError());
+        SDL_DestroySemaphore(capture->pending);
+        fclose(capture->file);
+        return false;
+    }
+
+    return true;
+}
+
+void capture_frame(struct c8_capture *capture, struct chip8 *c8, uint32_t frame, bool dirty)
+{
+    const bool SOUND_ON = c8->cpu->timer_sound > 0;
+    if (!dirty && SOUND_ON == capture->sound_on)
+    {
+        return;
+    }
+    capture->sound_on = SOUND_ON;
+
+    /* Only this thread writes tail, so it can be read without synchronisation. */
+    const int TAIL = SDL_AtomicGet(&capture->tail);
+    if (TAIL - SDL_AtomicGet(&capture->head) >= C8_CAPTURE_QUEUE_LEN)
+    {
+        SDL_AtomicAdd(&capture->dropped, 1);
+        return;
+    }
+
+    struct c8_capture_frame *slot = &capture->queue[TAIL % C8_CAPTURE_QUEUE_LEN];
+    slot->frame = frame;
+    slot->timer_sound = c8->cpu->timer_sound;
+    slot->flags = c8->display.hires ? C8_CAPTURE_HIRES : 0;
+    memcpy(slot->rows, c8->display.rows, sizeof slot->rows);
+
+    /* Publish the slot contents before the new tail becomes visible to the writer. */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&capture->tail, TAIL + 1);
+    SDL_SemPost(capture->pending);
+}
+
+void capture_close(struct c8_capture *capture)
+{
+    SDL_AtomicSet(&capture->running, 0);
+    SDL_SemPost(capture->pending);
+    SDL_WaitThread(capture->writer, NULL);
+    SDL_DestroySemaphore(capture->pending);
+    fclose(capture->file);
+
+    const int DROPPED = SDL_AtomicGet(&capture->dropped);
+    if (DROPPED > 0)
+    {
+        fprintf(stderr, "Capture dropped %d frames\n", DROPPED);
+    }
+}
+
+bool capture_read_header(FILE *file)
+{
+    char magic[sizeof CAPTURE_MAGIC - 1];
+    if (fread(magic, 1, sizeof magic, file) != sizeof magic ||
+            memcmp(magic, CAPTURE_MAGIC, sizeof magic) != 0)
+    {
+        fprintf(stderr, "Not a capture stream\n");
+        return false;
+    }
+    if (fgetc(file) != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "Unsupported capture version\n");
+        return false;
+    }
+    return true;
+}
+
+int capture_read_frame(FILE *file, struct c8_capture_frame *frame)
+{
+    /* Only a stream ending cleanly between records is the end of the capture. */
+    uint8_t header[8];
+    const size_t HEADER_LEN = fread(header, 1, sizeof header, file);
+    if (HEADER_LEN == 0 && feof(file))
+    {
+        return 0;
+    }
+    if (HEADER_LEN != sizeof header)
+    {
+        fprintf(stderr, ferror(file) ? "Failed to read capture record\n" :
+                "Truncated capture record header\n");
+        return -1;
+    }
+    frame->frame = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+    frame->timer_sound = header[4];
+    frame->flags = header[5];
+    const size_t PAYLOAD_LEN = header[6] | (header[7] << 8);
+
+    uint8_t bytes[C8_CAPTURE_FRAME_SIZE];
+    serialise(&frame->rows[0][0][0], bytes);
+
+    /* Each count is checked on its own, as their sum may wrap. */
+    size_t pos = 0;
+    size_t consumed = 0;
+    while (pos < sizeof bytes)
+    {
+        uint32_t zeros;
+        uint32_t literals;
+        if (!get_varint(file, &zeros, &consumed) || !get_varint(file, &literals, &consumed) ||
+                zeros > sizeof bytes - pos || literals > sizeof bytes - pos - zeros)
+        {
+            fprintf(stderr, "Malformed capture record at frame %u\n", frame->frame);
+            return -1;
+        }
+        pos += zeros;
+        for (uint32_t i = 0; i < literals; i++)
+        {
+            int c = fgetc(file);
+            if (c == EOF)
+            {
+                fprintf(stderr, "Truncated capture record at frame %u\n", frame->frame);
+                return -1;
+            }
+            bytes[pos++] ^= c;
+        }
+        consumed += literals;
+    }
+    if (consumed != PAYLOAD_LEN)
+    {
+        fprintf(stderr, "Capture record at frame %u has a payload of %zu bytes, expected %zu\n",
+                frame->frame, consumed, PAYLOAD_LEN);
+        return -1;
+    }
+
+    deserialise(bytes, &frame->rows[0][0][0]);
+    return 1;
+}
+
+static int capture_writer(void *data)
+{
+    struct c8_capture *capture = data;
+    bool ok = true;
+    while (true)
+    {
+        SDL_SemWait(capture->pending);
+        const int HEAD = SDL_AtomicGet(&capture->head);
+        if (HEAD == SDL_AtomicGet(&capture->tail))
+        {
+            if (!SDL_AtomicGet(&capture->running))
+            {
+                break;
+            }
+            continue;
+        }
+
+        /* Pair with the release in capture_frame before reading the slot. */
+        SDL_MemoryBarrierAcquire();
+        if (ok && !capture_write(capture, &capture->queue[HEAD % C8_CAPTURE_QUEUE_LEN]))
+        {
+            fprintf(stderr, "Failed to write capture frame\n");
+            ok = false;
+        }
+        SDL_AtomicSet(&capture->head, HEAD + 1);
+
+        /* Keep draining until the queue is empty, even if no further posts arrive. */
+        if (!SDL_AtomicGet(&capture->running))
+        {
+            SDL_SemPost(capture->pending);
+        }
+    }
+    fflush(capture->file);
+    return ok ? 0 : -1;
+}
+
+static bool capture_write(struct c8_capture *capture, const struct c8_capture_frame *frame)
+{
+    uint8_t current[C8_CAPTURE_FRAME_SIZE];
+    serialise(&frame->rows[0][0][0], current);
+
+    /* Even byte-by-byte alternating runs encode to well under twice the frame size. */
+    uint8_t payload[C8_CAPTURE_FRAME_SIZE * 2];
+    size_t len = 0;
+    size_t pos = 0;
+    while (pos < sizeof current)
+    {
+        size_t start = pos;
+        while (pos < sizeof current && current[pos] == capture->previous[pos])
+        {
+            pos++;
+        }
+        const size_t ZEROS = pos - start;
+
+        start = pos;
+        while (pos < sizeof current && current[pos] != capture->previous[pos])
+        {
+            pos++;
+        }
+
+        len += put_varint(&payload[len], ZEROS);
+        len += put_varint(&payload[len], pos - start);
+        for (size_t i = start; i < pos; i++)
+        {
+            payload[len++] = current[i] ^ capture->previous[i];
+        }
+    }
+    memcpy(capture->previous, current, sizeof current);
+
+    const uint8_t HEADER[8] =
+    {
+        frame->frame & 0xFF, (frame->frame >> 8) & 0xFF,
+        (frame->frame >> 16) & 0xFF, (frame->frame >> 24) & 0xFF,
+        frame->timer_sound, frame->flags, len & 0xFF, (len >> 8) & 0xFF
+    };
+    return fwrite(HEADER, 1, sizeof HEADER, capture->file) == sizeof HEADER &&
+        fwrite(payload, 1, len, capture->file) == len;
+}
+
+static void serialise(const uint64_t *words, uint8_t *bytes)
+{
+    for (int i = 0; i < C8_CAPTURE_FRAME_SIZE / 8; i++)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            bytes[i * 8 + b] = words[i] >> (56 - b * 8);
+        }
+    }
+}
+
+static void deserialise(const uint8_t *bytes, uint64_t *words)
+{
+    for (int i = 0; i < C8_CAPTURE_FRAME_SIZE / 8; i++)
+    {
+        words[i] = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            words[i] = (words[i] << 8) | bytes[i * 8 + b];
+        }
+    }
+}
+
+static size_t put_varint(uint8_t *out, uint32_t value)
+{
+    size_t len = 0;
+    do
+    {
+        out[len] = value & 0x7F;
+        value >>= 7;
+        out[len] |= value ? 0x80 : 0;
+        len++;
+    } while (value);
+    return len;
+}
+
+static bool get_varint(FILE *file, uint32_t *value, size_t *consumed)
+{
+    *value = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        int c = fgetc(file);
+        if (c == EOF)
+        {
+            return false;
+        }
+        (*consumed)++;
+        *value |= (uint32_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
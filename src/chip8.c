@@ -5,29 +5,50 @@
 
 #include <SDL2/SDL.h>
 
+#include "aot.h"
 #include "cpu.h"
+#include "debug.h"
+#include "snapshot.h"
+#include "watch.h"
 
 /* Global Definitions. */
-const uint16_t C8_MAX_ADDR = 0x1000;
 const uint16_t C8_LOAD_ADDR = 0x200;
 const size_t C8_SPRITE_LEN = 5;
+const uint16_t C8_BIG_FONT_ADDR = 0x50;
+const size_t C8_BIG_SPRITE_LEN = 10;
 const char *C8_WINDOW_TITLE = "CHIP-8";
 const int C8_FPS = 300;
 
 /* Static storage. */
 SDL_Window *window = NULL;
 SDL_Surface *back_buffer = NULL;
-const char *wav_file = "beep.wav";
-
-/* Audio */
+Uint32 palette[1 << C8_DISPLAY_PLANES];
+
+/* Audio, opened on the first non-zero sound timer or beep. */
+#define BEEP_RATE       44100
+#define BEEP_HZ         440
+#define BEEP_SAMPLES    (BEEP_RATE / 20)
+bool audio_attempted = false;
+bool audio_open = false;
 Uint8 *audio_pos;
 Uint32 audio_len;
-Uint32 wav_length;
-Uint8 *wav_buffer;
-SDL_AudioSpec wav_spec;
+Sint16 beep_buffer[BEEP_SAMPLES];
+SDL_AudioSpec beep_spec;
+
+/* The interpreter loop, with breakpoint and watchpoint checks compiled in when debug is true. */
+static inline int c8_loop(struct chip8 *c8, const bool debug);
+
+/*
+ * Emulate the next frame speculatively, render it, then roll back to the current state. Return
+ * true if the speculative frame drew to the display.
+ */
+static bool c8_run_ahead(struct chip8 *c8, bool drew);
+
+/* Print the per-phase startup timings once the first frame has been presented. */
+static void c8_startup_report(struct c8_startup *startup);
 
-/* Print the status of the C8 machine. */
-static void c8_print(struct chip8 *c8);
+/* Print the input-to-present latency percentiles. */
+static void c8_latency_report(struct c8_metrics *metrics);
 
 /* Process system flags such as beep/display and trigger system behaviours. */
 static void c8_process_flags(struct chip8 *c8);
@@ -39,7 +60,7 @@ static void c8_process_input(struct chip8 *c8);
 static bool c8_display_init(void);
 static void c8_display_destroy(void);
 static void c8_display_update(struct chip8 *c8);
-static void c8_display_draw(void);
+static void c8_display_draw(struct chip8 *c8);
 static void c8_keyboard_init(struct chip8 *c8);
 static void c8_handle_key_event(SDL_KeyboardEvent *key, struct chip8 *c8);
 
@@ -69,6 +90,27 @@ const uint8_t C8_FONTSET[] =
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+/* SUPER-CHIP/XO-CHIP 8x10 font, stored at C8_BIG_FONT_ADDR directly after the standard font. */
+const uint8_t C8_BIG_FONTSET[] =
+{
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
 /*
  * An ordered mapping of SDL keyboard symbols representing the configured input keys for 
  * manipulating the CHIP-8 keyboard. The index of the symbol represents the CHIP8 key that 
@@ -94,24 +136,54 @@ bool c8_init(struct chip8 *c8, struct c8_cpu *cpu)
     c8->cpu = cpu;
     cpu_init(cpu);
 
-    /* Clear memory, then inject the chip8 fontset at the start address. */
-    memset(c8->memory, 0, sizeof c8->memory);
+    /* Clear memory, then inject the chip8 fontsets at the start address. */
+    c8->mode = C8_MODE_CHIP8;
+    c8->timing = C8_TIMING_FIXED;
+    c8->memory = c8->core_memory;
+    c8->mem_size = sizeof c8->core_memory;
+    memset(c8->memory, 0, c8->mem_size);
     for (int i = 0; i < sizeof C8_FONTSET; i++)
     {
         c8->memory[i] = C8_FONTSET[i];
     }
-
-    /* Display init. */
-    if (!c8_display_init())
+    for (int i = 0; i < sizeof C8_BIG_FONTSET; i++)
     {
-        fprintf(stderr, "Failed to initialise display\n");
-        return false;
+        c8->memory[C8_BIG_FONT_ADDR + i] = C8_BIG_FONTSET[i];
     }
 
+    display_init(&c8->display);
+    memset(c8->audio_pattern, 0, sizeof c8->audio_pattern);
+    c8->pitch = 64;
     c8_keyboard_init(c8);
-    if (!c8_audio_init())
+
+    /* Flags init. */
+    c8->frame = 0;
+    c8->capture = NULL;
+    c8->aot = NULL;
+    c8->debugger = NULL;
+    c8->shared = NULL;
+    c8->watch = NULL;
+    c8->startup = NULL;
+    c8->metrics_export = NULL;
+    c8->run_ahead = NULL;
+    c8->input_pending = 0;
+    c8->input_key = 0;
+    c8->input_observed = false;
+    c8->input_draw_calls = 0;
+    c8->latency_report = false;
+    metrics_init(&c8->metrics);
+    c8->draw = false;
+    c8->beep = false;
+
+    return true;
+}
+
+bool c8_open(struct chip8 *c8)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (!c8_display_init())
     {
-        fprintf(stderr, "Failed to initialise audio\n");
+        fprintf(stderr, "Failed to initialise display\n");
         return false;
     }
 
@@ -120,13 +192,42 @@ bool c8_init(struct chip8 *c8, struct c8_cpu *cpu)
     SDL_FlushEvent(SDL_KEYDOWN);
     SDL_FlushEvent(SDL_KEYUP);
 
-    /* Flags init. */
-    c8->draw = false;
-    c8->beep = false;
-
+    if (c8->startup != NULL)
+    {
+        c8->startup->phase_ms[C8_PHASE_WINDOW] = c8_startup_ms(start);
+    }
     return true;
 }
 
+double c8_startup_ms(Uint64 since)
+{
+    return (SDL_GetPerformanceCounter() - since) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+bool c8_set_mode(struct chip8 *c8, enum c8_mode mode)
+{
+    if (mode == C8_MODE_XOCHIP && c8->memory == c8->core_memory)
+    {
+        uint8_t *memory = calloc(C8_XO_MEM_SIZE, 1);
+        if (memory == NULL)
+        {
+            fprintf(stderr, "Failed to allocate XO-CHIP memory\n");
+            return false;
+        }
+        memcpy(memory, c8->core_memory, sizeof c8->core_memory);
+        c8->memory = memory;
+        c8->mem_size = C8_XO_MEM_SIZE;
+    }
+    else if (mode != C8_MODE_XOCHIP && c8->memory != c8->core_memory)
+    {
+        memcpy(c8->core_memory, c8->memory, sizeof c8->core_memory);
+        free(c8->memory);
+        c8->memory = c8->core_memory;
+        c8->mem_size = sizeof c8->core_memory;
+    }
+    c8->mode = mode;
+    return true;
+}
 
 ssize_t c8_load(char *filename, struct chip8 *c8, uint16_t address)
 {
@@ -141,6 +242,12 @@ ssize_t c8_load(char *filename, struct chip8 *c8, uint16_t address)
     fseek(f, 0L, SEEK_END);
     long size = ftell(f);
     rewind(f);
+    if (size < 0 || address + size > c8->mem_size)
+    {
+        fprintf(stderr, "File size %ld exceeds available memory\n", size);
+        fclose(f);
+        return ERROR_VALUE;
+    }
     size_t bytes_read = fread(&c8->memory[address],1, size, f);
     if (bytes_read != size)
     {
@@ -159,41 +266,245 @@ int c8_run(struct chip8 *c8, uint16_t start_address)
     printf("CHIP-8 Run\n");
     c8->cpu->pc = start_address;
     c8->alive = true;
-    Uint32 start;
+
+    /* Each call is specialised by the compiler, so only the debug variant checks breakpoints. */
+    if ((c8->debugger != NULL ? c8_loop(c8, true) : c8_loop(c8, false)) != 0)
+    {
+        return -1;
+    }
+    c8_destroy(c8);
+    return 0;
+}
+
+static inline int c8_loop(struct chip8 *c8, const bool debug)
+{
+    /* Under fixed timing each batch is a single instruction, under VIP timing a 60 Hz frame. */
+    const bool VIP = c8->timing == C8_TIMING_VIP;
+    const Uint32 BUDGET = VIP ? C8_VIP_FRAME_CYCLES : 1;
+    const Uint32 PERIOD_US = 1000000 / (VIP ? 60 : C8_FPS);
+    const Uint64 FREQUENCY = SDL_GetPerformanceFrequency();
+    const Uint64 PERIOD = FREQUENCY / (VIP ? 60 : C8_FPS);
+    Uint64 deadline = SDL_GetPerformanceCounter();
+    Uint64 frame_start;
+    Uint32 frame_us;
+    bool stepped;
+    bool dirty;
+    bool ahead_drew = false;
+    bool ahead_pending = false;
+
+    /* Run-ahead speculates one 60 Hz frame, so under fixed timing it spans C8_FPS / 60 batches. */
+    const Uint32 AHEAD_BATCHES = VIP ? 1 : C8_FPS / 60;
     while (c8->alive)
     {
-        start = SDL_GetTicks();
-        c8_print(c8);
-        if (!cpu_step(c8))
+        /* Wait before, rather than after, each batch so input is sampled as late as possible. */
+        frame_start = SDL_GetPerformanceCounter();
+        if (frame_start < deadline)
+        {
+            SDL_Delay((deadline - frame_start) * 1000 / FREQUENCY);
+            frame_start = SDL_GetPerformanceCounter();
+        }
+        else if (frame_start - deadline > PERIOD)
         {
-            fprintf(stderr, "CPU exception occurred\n");
-            return -1;
+            /* Fallen behind, perhaps in the debugger, so don't rush to catch up. */
+            deadline = frame_start;
         }
+        deadline += PERIOD;
+
         c8_process_input(c8);
+        if (c8->shared != NULL)
+        {
+            shared_input(c8->shared, c8);
+        }
+        if (!c8->alive)
+        {
+            break;
+        }
+
+        /* Only between batches, as a reload replaces the state an instruction may be using. */
+        if (c8->watch != NULL && c8->watch->reload)
+        {
+            watch_reload(c8->watch, c8);
+        }
+
+        /*
+         * The only pacing check per instruction is whether the frame's budget is spent. A batch
+         * is skipped entirely while cycles carried over from an earlier one still cover it.
+         */
+        while (c8->alive && c8->cpu->cycles < BUDGET)
+        {
+            if (debug && (c8->debugger->stop || (c8->debugger->flags[c8->cpu->pc] & C8_DEBUG_BREAK)))
+            {
+                if (!debug_break(c8))
+                {
+                    c8->alive = false;
+                    break;
+                }
+            }
+
+            /* Compiled blocks count their own instructions. */
+            if (c8->aot != NULL)
+            {
+                stepped = aot_step(c8);
+            }
+            else
+            {
+                stepped = cpu_step(c8);
+                c8->metrics.instructions++;
+            }
+            if (!stepped)
+            {
+                fprintf(stderr, "CPU exception occurred\n");
+                return -1;
+            }
+        }
+        if (!c8->alive)
+        {
+            break;
+        }
+
+        /* Cycles overrunning the budget, such as a slow clear, are carried into the next frame. */
+        c8->cpu->cycles -= c8->cpu->cycles < BUDGET ? c8->cpu->cycles : BUDGET;
+        if (VIP)
+        {
+            cpu_decrement_timers(c8);
+        }
+
+        dirty = c8->draw;
+        if (!debug && c8->run_ahead != NULL)
+        {
+            /* Hold real draws back until the next speculation so they don't replace its output. */
+            ahead_pending |= c8->draw;
+            c8->draw = false;
+            if (c8->frame % AHEAD_BATCHES == 0)
+            {
+                c8->draw = ahead_pending;
+                ahead_pending = false;
+                ahead_drew = c8_run_ahead(c8, ahead_drew);
+            }
+        }
         c8_process_flags(c8);
-        c8_display_draw();
+        c8_display_draw(c8);
+        if (c8->startup != NULL && !c8->startup->reported)
+        {
+            c8_startup_report(c8->startup);
+        }
+        if (c8->capture != NULL)
+        {
+            capture_frame(c8->capture, c8, c8->frame, dirty);
+        }
+        if (c8->shared != NULL)
+        {
+            shared_publish(c8->shared, c8, c8->frame);
+        }
+        c8->frame++;
 
-        if (1000/C8_FPS > SDL_GetTicks() - start)
+        frame_us = metrics_elapsed_us(frame_start);
+        metrics_record(&c8->metrics.hist[C8_HIST_FRAME], frame_us);
+        if (frame_us > PERIOD_US)
+        {
+            c8->metrics.overruns++;
+        }
+        if (c8->metrics_export != NULL)
         {
-            SDL_Delay(1000/C8_FPS-(SDL_GetTicks()-start));
+            metrics_export_tick(c8->metrics_export, &c8->metrics);
         }
     }
-    c8_destroy(c8);
     return 0;
 }
 
+static bool c8_run_ahead(struct chip8 *c8, bool drew)
+{
+    /* A frame is the VIP cycle budget, or under fixed timing, C8_FPS / 60 single cycle steps. */
+    const Uint32 BUDGET = c8->timing == C8_TIMING_VIP ? C8_VIP_FRAME_CYCLES : C8_FPS / 60;
+    const bool ALIVE = c8->alive;
+    const bool DRAW = c8->draw;
+    snapshot_save(c8, c8->run_ahead);
+
+    /* Speculative writes are rolled back, so they must not invalidate blocks or hit watchpoints. */
+    struct c8_aot *const AOT = c8->aot;
+    struct c8_debugger *const DEBUGGER = c8->debugger;
+    c8->aot = NULL;
+    c8->debugger = NULL;
+
+    /* Stop short of FX0A, which would block on the keyboard, and leave faults to the real step. */
+    c8->draw = false;
+    while (c8->cpu->cycles < BUDGET)
+    {
+        if ((c8_mem_read16(c8, c8->cpu->pc) & 0xF0FF) == 0xF00A || !cpu_step(c8))
+        {
+            break;
+        }
+    }
+
+    /* Under VIP timing the run loop ticks the timers once the frame's batch is done. */
+    if (c8->timing == C8_TIMING_VIP)
+    {
+        cpu_decrement_timers(c8);
+    }
+
+    /* Also render if the previous frame drew, as that draw may not have been repeated. */
+    const bool AHEAD_DRAW = c8->draw;
+    if (DRAW || AHEAD_DRAW || drew)
+    {
+        c8_display_update(c8);
+    }
+
+    snapshot_restore(c8, c8->run_ahead);
+    c8->aot = AOT;
+    c8->debugger = DEBUGGER;
+    c8->alive = ALIVE;
+    c8->draw = false;
+    return AHEAD_DRAW;
+}
+
 void c8_destroy(struct chip8 *c8)
 {
     printf("CHIP-8 Destroy\n");
+    if (c8->capture != NULL)
+    {
+        capture_close(c8->capture);
+        c8->capture = NULL;
+    }
+    if (c8->latency_report)
+    {
+        c8_latency_report(&c8->metrics);
+    }
+    if (c8->metrics_export != NULL)
+    {
+        metrics_export_close(c8->metrics_export, &c8->metrics);
+        c8->metrics_export = NULL;
+    }
+    if (c8->debugger != NULL)
+    {
+        debug_destroy(c8->debugger);
+        c8->debugger = NULL;
+    }
+    if (c8->shared != NULL)
+    {
+        shared_close(c8->shared);
+        c8->shared = NULL;
+    }
+    if (c8->watch != NULL)
+    {
+        watch_close(c8->watch);
+        c8->watch = NULL;
+    }
     c8_display_destroy();
     c8_audio_destroy();
     SDL_Quit();
+
+    if (c8->memory != c8->core_memory)
+    {
+        free(c8->memory);
+        c8->memory = c8->core_memory;
+        c8->mem_size = sizeof c8->core_memory;
+    }
 }
 
 uint8_t c8_mem_read8(struct chip8 *c8, uint16_t addr)
 {
     /* Allow access to all CHIP8 memory from the start to the end of the address space. */
-    assert(addr <= C8_MAX_ADDR);
+    assert(addr < c8->mem_size);
     return c8->memory[addr];    
 }
 
@@ -206,47 +517,72 @@ void c8_mem_write8(struct chip8 *c8, uint16_t addr, uint8_t value)
 {
     /* It is only valid to write memory within the bounds of the C8 program ROM. */
     assert(addr >= C8_LOAD_ADDR);
-    assert(addr <= C8_MAX_ADDR);
+    assert(addr < c8->mem_size);
     c8->memory[addr] = value;
+    if (c8->aot != NULL)
+    {
+        aot_write(c8->aot, addr);
+    }
+    if (c8->debugger != NULL)
+    {
+        debug_watch(c8, addr);
+    }
 }
 bool c8_key_pressed(struct chip8 *c8, uint8_t key)
 {
-    return c8->keyboard[key] > 0 ? true : false;
+    if (!c8->keyboard[key])
+    {
+        return false;
+    }
+
+    /* Latency is counted from the first render after the program has seen the press. */
+    if (c8->input_pending != 0 && !c8->input_observed && key == c8->input_key)
+    {
+        c8->input_observed = true;
+        c8->input_draw_calls = c8->metrics.draw_calls;
+    }
+    return true;
 }
 
 uint8_t c8_key_await(struct chip8 *c8)
 {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    /* The run loop won't publish again until a key arrives, so show clients the machine waiting. */
+    if (c8->shared != NULL)
+    {
+        shared_publish(c8->shared, c8, c8->frame);
+    }
     while (true)
     {
+        if (!c8->alive || (c8->watch != NULL && c8->watch->reload))
+        {
+            return C8_KEY_NONE;
+        }
         for (int i = 0; i < 16; i++)
         {
             if (c8_key_pressed(c8, i))
             {
+                const Uint32 BLOCKED_US = metrics_elapsed_us(start);
+                metrics_record(&c8->metrics.hist[C8_HIST_INPUT], BLOCKED_US);
+                c8->metrics.input_blocked_us += BLOCKED_US;
                 return i;
             }
         }        
         c8_process_input(c8);
+        if (c8->shared != NULL)
+        {
+            shared_input(c8->shared, c8);
+        }
     }
 }
 
-static void c8_print(struct chip8 *c8)
-{
-    printf("[PC:%#04x, SP:%#04x, I:%#04x, OP:%#04x]\n[TIMER_DELAY:%#04x, TIMER_SND:%#04x]\n", 
-            c8->cpu->pc, c8->cpu->sp, c8->cpu->i, c8_mem_read16(c8, c8->cpu->pc), 
-            c8->cpu->timer_delay, c8->cpu->timer_sound);
-    for (int i = 0; i <= 0xF; i++)
-    {
-        printf("\tv%x:%04x    s%x:%#04x\n", i, c8->cpu->v[i], i, c8->cpu->stack[i]);
-    }
-    printf("-------------------------------------------\n");
-}
-
 static bool c8_display_init(void)
 {
     static const int DISPLAY_WIDTH = 640;
     static const int DISPLAY_HEIGHT = 480;
 
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
     {
         fprintf(stderr, "Failed to init SDL: %s\n", SDL_GetError());
         return false;
@@ -260,13 +596,19 @@ static bool c8_display_init(void)
         return false;
     }
 
-    back_buffer = SDL_CreateRGBSurface(0, C8_DISPLAY_WIDTH, C8_DISPLAY_HEIGHT, 32, 0, 0, 0, 0);
+    back_buffer = SDL_CreateRGBSurface(0, C8_HIRES_WIDTH, C8_HIRES_HEIGHT, 32, 0, 0, 0, 0);
     if (back_buffer == NULL)
     {
         fprintf(stderr, "Failed to create surface: %s\n", SDL_GetError());
         return false;
     }
 
+    /* Colour indices are formed from the plane bits, CHIP-8 and SUPER-CHIP only use 0 and 1. */
+    palette[0] = SDL_MapRGB(back_buffer->format, 0x00, 0x00, 0x00);
+    palette[1] = SDL_MapRGB(back_buffer->format, 0x00, 0xFF, 0x00);
+    palette[2] = SDL_MapRGB(back_buffer->format, 0xFF, 0x00, 0xFF);
+    palette[3] = SDL_MapRGB(back_buffer->format, 0xFF, 0xFF, 0xFF);
+
     return true;
 }
 
@@ -279,6 +621,22 @@ static void c8_display_destroy(void)
 
 static void c8_process_flags(struct chip8 *c8)
 {
+    /* A short sound may expire within the frame, so its beep also opens audio before playing. */
+    if (!audio_attempted && (c8->cpu->timer_sound > 0 || c8->beep))
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        audio_attempted = true;
+        audio_open = c8_audio_init();
+        if (!audio_open)
+        {
+            fprintf(stderr, "Failed to initialise audio, continuing without sound\n");
+        }
+        if (c8->startup != NULL)
+        {
+            c8->startup->phase_ms[C8_PHASE_AUDIO] = c8_startup_ms(start);
+        }
+    }
+
     if (c8->draw)
     {
         c8->draw = false;
@@ -287,7 +645,14 @@ static void c8_process_flags(struct chip8 *c8)
 
     if (c8->beep)
     {
-        c8_audio_beep();
+        if (audio_open)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            c8_audio_beep();
+            const Uint32 BLOCKED_US = metrics_elapsed_us(start);
+            metrics_record(&c8->metrics.hist[C8_HIST_AUDIO], BLOCKED_US);
+            c8->metrics.audio_blocked_us += BLOCKED_US;
+        }
         c8->beep = false;
     }
 }
@@ -300,11 +665,26 @@ static void c8_handle_key_event(SDL_KeyboardEvent *key_event, struct chip8 *c8)
         c8->alive = false;
         return;
     }
+    if (key.sym == SDLK_F5 && key_event->type == SDL_KEYDOWN && c8->watch != NULL)
+    {
+        watch_save(c8->watch, c8);
+        return;
+    }
     for (int index = 0; index < 16; index++)
     {
         if (key.sym == KEYMAP[index])
         {
             c8->keyboard[index] = key_event->type == SDL_KEYDOWN ? true : false;
+            /* A press the program has yet to read is replaced, it may never look for that key. */
+            if (key_event->type == SDL_KEYDOWN && !key_event->repeat && !c8->input_observed)
+            {
+                /* Back-date the press by the time its event spent queued, in millisecond ticks. */
+                const Uint32 QUEUED_MS = SDL_GetTicks() - key_event->timestamp;
+                c8->input_pending = SDL_GetPerformanceCounter() -
+                    (Uint64)QUEUED_MS * SDL_GetPerformanceFrequency() / 1000;
+                c8->input_key = index;
+                c8->input_observed = false;
+            }
         }
     }
 }
@@ -324,6 +704,11 @@ static void c8_process_input(struct chip8 *c8)
                 c8->alive = false;
                 break;
             default:
+                /* ROM changes arrive as events, so watching adds nothing to the loop itself. */
+                if (c8->watch != NULL && event.type == c8->watch->event)
+                {
+                    c8->watch->reload = true;
+                }
                 break;
         }
     }
@@ -331,36 +716,49 @@ static void c8_process_input(struct chip8 *c8)
 
 static void c8_display_update(struct chip8 *c8)
 {
-    SDL_FillRect(back_buffer, NULL, SDL_MapRGB(back_buffer->format, 0, 0, 0));
-    SDL_Rect rect = { .w = 1, .h = 1 };
-    for (int x = 0; x < C8_DISPLAY_WIDTH; x++)
+    Uint64 start = SDL_GetPerformanceCounter();
+    c8->metrics.draw_calls++;
+
+    /* The back buffer is always hires, lores pixels are doubled in both directions. */
+    const int SHIFT = c8->display.hires ? 0 : 1;
+    SDL_LockSurface(back_buffer);
+    for (int y = 0; y < C8_HIRES_HEIGHT; y++)
     {
-        for (int y = 0; y < C8_DISPLAY_HEIGHT; y++)
+        Uint32 *row = (Uint32 *)((Uint8 *)back_buffer->pixels + y * back_buffer->pitch);
+        for (int x = 0; x < C8_HIRES_WIDTH; x++)
         {
-            rect.y = y;
-            rect.x = x;
-            if (c8->display[x + y * C8_DISPLAY_WIDTH] > 0)
-            {
-                SDL_FillRect(back_buffer, &rect, SDL_MapRGB(back_buffer->format, 0x00, 0xFF, 0x00));
-            }
+            row[x] = palette[display_pixel(&c8->display, x >> SHIFT, y >> SHIFT)];
         }
-    } 
+    }
+    SDL_UnlockSurface(back_buffer);
 
     SDL_BlitScaled(back_buffer, NULL, SDL_GetWindowSurface(window), NULL);
+    metrics_record(&c8->metrics.hist[C8_HIST_DRAW], metrics_elapsed_us(start));
 }
 
 static bool c8_audio_init(void)
 {
-    if (SDL_LoadWAV(wav_file, &wav_spec, &wav_buffer, &wav_length) == NULL)
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
     {
-        fprintf(stderr, "Failed to load wav file: %s\n", SDL_GetError());
+        fprintf(stderr, "Failed to init SDL audio: %s\n", SDL_GetError());
         return false;
     }
 
-    wav_spec.callback = c8_audio_callback;
-    wav_spec.userdata = NULL;
+    /* Generate a 50ms square wave rather than loading a sample from disk. */
+    for (int i = 0; i < BEEP_SAMPLES; i++)
+    {
+        beep_buffer[i] = (i * 2 * BEEP_HZ / BEEP_RATE) % 2 ? -3000 : 3000;
+    }
+
+    memset(&beep_spec, 0, sizeof beep_spec);
+    beep_spec.freq = BEEP_RATE;
+    beep_spec.format = AUDIO_S16SYS;
+    beep_spec.channels = 1;
+    beep_spec.samples = 1024;
+    beep_spec.callback = c8_audio_callback;
+    beep_spec.userdata = NULL;
 
-    if (SDL_OpenAudio(&wav_spec, NULL) < 0)
+    if (SDL_OpenAudio(&beep_spec, NULL) < 0)
     {
         fprintf(stderr, "Failed to open audio device: %s\n", SDL_GetError());
         return false;
@@ -371,8 +769,11 @@ static bool c8_audio_init(void)
 
 static void c8_audio_destroy(void)
 {
-    SDL_FreeWAV(wav_buffer);
-    SDL_CloseAudio();
+    if (audio_open)
+    {
+        SDL_CloseAudio();
+        audio_open = false;
+    }
 }
 
 static void c8_audio_callback(void *userdata, Uint8 *stream, int len)
@@ -389,8 +790,8 @@ static void c8_audio_callback(void *userdata, Uint8 *stream, int len)
 
 static void c8_audio_beep(void)
 {
-    audio_pos = wav_buffer;
-    audio_len = wav_length;
+    audio_pos = (Uint8 *)beep_buffer;
+    audio_len = sizeof beep_buffer;
     SDL_PauseAudio(0);
     while (audio_len > 0)
     {
@@ -401,6 +802,7 @@ static void c8_audio_beep(void)
 
 static void c8_keyboard_init(struct chip8 *c8)
 {
+    memset(c8->keyboard, 0, sizeof c8->keyboard);
     KEYMAP[0]   = SDLK_x;
     KEYMAP[1]   = SDLK_1;
     KEYMAP[2]   = SDLK_2;
@@ -419,7 +821,50 @@ static void c8_keyboard_init(struct chip8 *c8)
     KEYMAP[0xF] = SDLK_v;
 }
 
-static void c8_display_draw(void)
+static void c8_display_draw(struct chip8 *c8)
 {
+    c8->metrics.frames++;
     SDL_UpdateWindowSurface(window);
+
+    /* Any render since the program read the key press reflects it. */
+    if (c8->input_observed && c8->metrics.draw_calls != c8->input_draw_calls)
+    {
+        metrics_record(&c8->metrics.hist[C8_HIST_LATENCY], metrics_elapsed_us(c8->input_pending));
+        c8->input_pending = 0;
+        c8->input_observed = false;
+    }
+}
+
+static void c8_startup_report(struct c8_startup *startup)
+{
+    startup->reported = true;
+    startup->phase_ms[C8_PHASE_FIRST_FRAME] = c8_startup_ms(startup->origin);
+    fprintf(stderr, "Startup report (ms):\n"
+            "  init          %8.3f\n"
+            "  rom load      %8.3f (in parallel with window)\n"
+            "  window        %8.3f\n"
+            "  first frame   %8.3f (since start)\n",
+            startup->phase_ms[C8_PHASE_INIT], startup->phase_ms[C8_PHASE_LOAD],
+            startup->phase_ms[C8_PHASE_WINDOW], startup->phase_ms[C8_PHASE_FIRST_FRAME]);
+    if (audio_attempted)
+    {
+        fprintf(stderr, "  audio         %8.3f\n", startup->phase_ms[C8_PHASE_AUDIO]);
+    }
+    else
+    {
+        fprintf(stderr, "  audio         deferred until first sound\n");
+    }
+}
+
+static void c8_latency_report(struct c8_metrics *metrics)
+{
+    const struct c8_histogram *hist = &metrics->hist[C8_HIST_LATENCY];
+    fprintf(stderr, "Input latency report (ms, %llu presses):\n"
+            "  p50           %8.3f\n"
+            "  p90           %8.3f\n"
+            "  p99           %8.3f\n"
+            "  max           %8.3f\n",
+            (unsigned long long)hist->count, metrics_percentile(hist, 0.5) / 1000.0,
+            metrics_percentile(hist, 0.9) / 1000.0, metrics_percentile(hist, 0.99) / 1000.0,
+            hist->max / 1000.0);
 }
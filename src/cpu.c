@@ -9,7 +9,9 @@
 
 const size_t C8_INS_LEN = 2;
 
-static void decrement_timers(struct chip8 *c8);
+static void vip_clock(struct chip8 *c8, uint16_t op);
+static bool exec_extended_sys(struct chip8 *c8, uint16_t op);
+static uint16_t skip_len(struct chip8 *c8);
 static void push(struct c8_cpu *cpu, uint16_t value);
 static uint16_t pop(struct c8_cpu *cpu);
 
@@ -30,12 +32,19 @@ void cpu_init(struct c8_cpu *cpu)
         cpu->stack[i] = 0;
     }
 
+    // Clear persistent flags
+    for (int i = 0; i <= 0xF; i++)
+    {
+        cpu->rpl[i] = 0;
+    }
+
     // Clear timers
     cpu->timer_delay = 0;
     cpu->timer_sound = 0;
+    cpu->cycles = 0;
 
-    // Seed the PRNG for op 0xCXNN [RND Vx, byte]
-    srand(time(NULL));
+    // Seed the PRNG for op 0xCXNN [RND Vx, byte], xorshift never leaves a zero state
+    cpu->rng = (uint32_t)time(NULL) | 1;
 }
 
 bool cpu_step(struct chip8 *c8)
@@ -48,6 +57,9 @@ bool cpu_step(struct chip8 *c8)
     const uint16_t OP_NN  = ((OP & 0x00FF) >> 0);
     const uint16_t OP_NNN = ((OP & 0x0FFF) >> 0);
 
+    // Costs depend on the operands, so are charged before the instruction changes them
+    cpu_clock(c8, OP);
+
     cpu->pc += C8_INS_LEN;
 
     switch (OP & 0xF000)
@@ -55,11 +67,15 @@ bool cpu_step(struct chip8 *c8)
         case 0x0:
             // Note, there is a further instruction 0nnn (SYS addr) but this is to be 
             // ignored by modern interpreters
+            if (c8->mode != C8_MODE_CHIP8 && OP_X == 0 && exec_extended_sys(c8, OP))
+            {
+                break;
+            }
             switch (OP & 0xFF)
             {
                 case 0xE0:
                     // 0x00E0: clear the display
-                    memset(&c8->display, 0, sizeof c8->display);
+                    display_clear(&c8->display);
                     c8->draw = true;
                     break;
                 case 0xEE:
@@ -84,15 +100,37 @@ bool cpu_step(struct chip8 *c8)
             break;
         case 0x3000:
             // 0x3XNN: skip the next instruction if VX equals NN
-            cpu->pc += (cpu->v[OP_X] == OP_NN) ? C8_INS_LEN : 0;
+            cpu->pc += (cpu->v[OP_X] == OP_NN) ? skip_len(c8) : 0;
             break;
         case 0x4000:
             // 0x4XNN: skip the next instruction if VX doesn't equal NN
-            cpu->pc += (cpu->v[OP_X] != OP_NN) ? C8_INS_LEN : 0;
+            cpu->pc += (cpu->v[OP_X] != OP_NN) ? skip_len(c8) : 0;
             break;
         case 0x5000:
+            if (c8->mode == C8_MODE_XOCHIP && (OP_N == 0x2 || OP_N == 0x3))
+            {
+                // 0x5XY2: store vx through vy in memory starting at I, I is not modified
+                // 0x5XY3: load vx through vy from memory starting at I, I is not modified
+                const int STEP = OP_X <= OP_Y ? 1 : -1;
+                for (int reg = OP_X, offset = 0; ; reg += STEP, offset++)
+                {
+                    if (OP_N == 0x2)
+                    {
+                        c8_mem_write8(c8, cpu->i + offset, cpu->v[reg]);
+                    }
+                    else
+                    {
+                        cpu->v[reg] = c8_mem_read8(c8, cpu->i + offset);
+                    }
+                    if (reg == OP_Y)
+                    {
+                        break;
+                    }
+                }
+                break;
+            }
             // 0x5XY0: skip the next instruction if VX equals VY
-            cpu->pc += (cpu->v[OP_X] == cpu->v[OP_Y]) ? C8_INS_LEN : 0;
+            cpu->pc += (cpu->v[OP_X] == cpu->v[OP_Y]) ? skip_len(c8) : 0;
             break;
         case 0x6000:
             // 0x6XNN: set VX to NN
@@ -138,10 +176,23 @@ bool cpu_step(struct chip8 *c8)
                     break;
                 }
                 case 0x6:
+                {
                     // 0x8XY6: store the value of vy shifted one bit right in vx, set vf to lsb(vf) prior to the shift
-                    cpu->v[0xF] = cpu->v[OP_Y] & 1;
-                    cpu->v[OP_X] = cpu->v[OP_Y] >> 1;
+                    // SUPER-CHIP shifts vx in place and ignores vy
+                    const uint8_t SRC = c8->mode == C8_MODE_SCHIP ? cpu->v[OP_X] : cpu->v[OP_Y];
+                    // plain CHIP-8 writes vf first, so with X=F the shifted value is kept as before
+                    if (c8->mode == C8_MODE_CHIP8)
+                    {
+                        cpu->v[0xF] = SRC & 1;
+                        cpu->v[OP_X] = SRC >> 1;
+                    }
+                    else
+                    {
+                        cpu->v[OP_X] = SRC >> 1;
+                        cpu->v[0xF] = SRC & 1;
+                    }
                     break;
+                }
                 case 0x7:
                 {
                     // 0x8XY7: set vx to vy - vx, vf is set to 0 when there is borrow, 1 when not
@@ -151,17 +202,30 @@ bool cpu_step(struct chip8 *c8)
                     break;
                 }
                 case 0xE:
+                {
                     // 0x8XYE: store vy shifted one bit left in vx, set vf to the msb of vx prior to shift
-                    cpu->v[0xF] = cpu->v[OP_Y] >> 7;
-                    cpu->v[OP_X] = cpu->v[OP_Y] << 1;
+                    // SUPER-CHIP shifts vx in place and ignores vy
+                    const uint8_t SRC = c8->mode == C8_MODE_SCHIP ? cpu->v[OP_X] : cpu->v[OP_Y];
+                    // plain CHIP-8 writes vf first, so with X=F the shifted value is kept as before
+                    if (c8->mode == C8_MODE_CHIP8)
+                    {
+                        cpu->v[0xF] = SRC >> 7;
+                        cpu->v[OP_X] = SRC << 1;
+                    }
+                    else
+                    {
+                        cpu->v[OP_X] = SRC << 1;
+                        cpu->v[0xF] = SRC >> 7;
+                    }
                     break;
+                }
                 default:
                     goto illegal_op;
             }
             break;
         case 0x9000:
             // 0x9XY0: skip the next instruction if vx doesnt equal vy
-            cpu->pc += (cpu->v[OP_X] != cpu->v[OP_Y]) ? C8_INS_LEN : 0;
+            cpu->pc += (cpu->v[OP_X] != cpu->v[OP_Y]) ? skip_len(c8) : 0;
             break;
         case 0xA000:
             // 0xANNN: set I to the address NNN
@@ -169,48 +233,27 @@ bool cpu_step(struct chip8 *c8)
             break;
         case 0xB000:
             // 0xBNNN: jump to the address NNN plus V0
-            cpu->pc = OP_NNN + cpu->v[0];
+            // SUPER-CHIP decodes this as 0xBXNN, jumping to XNN plus VX
+            cpu->pc = OP_NNN + cpu->v[c8->mode == C8_MODE_SCHIP ? OP_X : 0];
             break;
         case 0xC000:
             // 0xCXNN: set VX to the result of bitwise AND between NN and rand(0,255)
-            cpu->v[OP_X] = (rand() % 256) & OP_NN;
+            cpu->v[OP_X] = cpu_random(cpu) & OP_NN;
             break;
         case 0xD000:
-        {
-            // 0xDXYN: sprite drawing
-            const uint8_t HEIGHT = OP_N;
-            const uint8_t X = cpu->v[OP_X];
-            const uint8_t Y = cpu->v[OP_Y];
-
-            cpu->v[0xF] = 0;
-            c8->draw = true;
-            for (int row = 0; row < HEIGHT; row++)
-            {
-                const uint8_t PIXEL = c8_mem_read8(c8, cpu->i + row);
-                for (int column = 0; column < 8; column++)
-                {
-                    if ((PIXEL & (0x80 >> column)) != 0)
-                    {
-                        if (c8->display[column+X+(row+Y)*C8_DISPLAY_WIDTH])
-                        {
-                            cpu->v[0xF] = 1;
-                        }
-                        c8->display[column+X+(row+Y)*C8_DISPLAY_WIDTH] ^= 1;
-                    }
-                }
-            }
+            // 0xDXYN: sprite drawing, 0xDXY0 draws a 16x16 sprite in SUPER-CHIP/XO-CHIP
+            cpu_draw_sprite(c8, cpu->v[OP_X], cpu->v[OP_Y], OP_N);
             break;
-        }
         case 0xE000:
             switch (OP & 0xFF)
             {
                 case 0x9E:
                     // 0xEX9E: skip the next instruction if the key stored in vx is pressed
-                    cpu->pc += c8_key_pressed(c8, cpu->v[OP_X]) ? C8_INS_LEN : 0;
+                    cpu->pc += c8_key_pressed(c8, cpu->v[OP_X]) ? skip_len(c8) : 0;
                     break;
                 case 0xA1: 
                     // 0xEXA1: skip the next instruction if the key stored in vx is not pressed
-                    cpu->pc += c8_key_pressed(c8, cpu->v[OP_X]) ? 0: C8_INS_LEN;
+                    cpu->pc += c8_key_pressed(c8, cpu->v[OP_X]) ? 0: skip_len(c8);
                     break;
                 default:
                     goto illegal_op;
@@ -219,15 +262,54 @@ bool cpu_step(struct chip8 *c8)
         case 0xF000:
             switch (OP & 0xFF)
             {
+                case 0x00:
+                    // 0xF000 NNNN: set I to the 16-bit address stored in the following word
+                    if (c8->mode != C8_MODE_XOCHIP || OP_X != 0)
+                    {
+                        goto illegal_op;
+                    }
+                    cpu->i = c8_mem_read16(c8, cpu->pc);
+                    cpu->pc += C8_INS_LEN;
+                    break;
+                case 0x01:
+                    // 0xFN01: select the drawing planes given by the bitmask N
+                    if (c8->mode != C8_MODE_XOCHIP)
+                    {
+                        goto illegal_op;
+                    }
+                    c8->display.planes = OP_X & ((1 << C8_DISPLAY_PLANES) - 1);
+                    break;
+                case 0x02:
+                    // 0xF002: load the 16 byte audio pattern buffer from memory starting at I
+                    if (c8->mode != C8_MODE_XOCHIP || OP_X != 0)
+                    {
+                        goto illegal_op;
+                    }
+                    for (int i = 0; i < sizeof c8->audio_pattern; i++)
+                    {
+                        c8->audio_pattern[i] = c8_mem_read8(c8, cpu->i + i);
+                    }
+                    break;
                 case 0x07:
                     // 0xFX07: store the current value of the delay timer in VX
                  
                     cpu->v[OP_X] = cpu->timer_delay;
                     break;
                 case 0x0A:
-                    // 0xFX0A: a key press is awaited, then stored in vx
-                    cpu->v[OP_X] = c8_key_await(c8);
+                {
+                    // 0xFX0A: a key press is awaited, then stored in vx, an abandoned wait is
+                    // executed again
+                    const uint8_t KEY = c8_key_await(c8);
+                    if (KEY == C8_KEY_NONE)
+                    {
+                        cpu->pc -= C8_INS_LEN;
+                    }
+                    else
+                    {
+                        cpu->v[OP_X] = KEY;
+                    }
                     break;
+                }
                 case 0x15:
                     // 0xFX15: set the delay timer to vx
                     cpu->timer_delay = cpu->v[OP_X];
@@ -244,6 +326,22 @@ bool cpu_step(struct chip8 *c8)
                     // 0xFX29: set i to the location of the sprite character stored in x
                     cpu->i = cpu->v[OP_X] * C8_SPRITE_LEN;
                     break;
+                case 0x30:
+                    // 0xFX30: set i to the location of the large sprite character stored in x
+                    if (c8->mode == C8_MODE_CHIP8)
+                    {
+                        goto illegal_op;
+                    }
+                    cpu->i = C8_BIG_FONT_ADDR + (cpu->v[OP_X] & 0xF) * C8_BIG_SPRITE_LEN;
+                    break;
+                case 0x3A:
+                    // 0xFX3A: set the audio pitch register to vx
+                    if (c8->mode != C8_MODE_XOCHIP)
+                    {
+                        goto illegal_op;
+                    }
+                    c8->pitch = cpu->v[OP_X];
+                    break;
                 case 0x33:
                     // 0xFX33: store BCD repreentation of vx in memory locations i, i+1, i+2
                     c8_mem_write8(c8, cpu->i, cpu->v[OP_X] / 100);
@@ -256,7 +354,8 @@ bool cpu_step(struct chip8 *c8)
                     {
                         c8_mem_write8(c8, cpu->i + i, cpu->v[i]);
                     }
-                    cpu->i += OP_X + 1; 
+                    // SUPER-CHIP leaves I unmodified
+                    cpu->i += c8->mode == C8_MODE_SCHIP ? 0 : OP_X + 1; 
                     break;
                 case 0x65:
                     // 0xFX65: fill v0 to vx (including vx) with values from memory starting at i
@@ -264,7 +363,24 @@ bool cpu_step(struct chip8 *c8)
                     {
                         cpu->v[i] = c8_mem_read8(c8, cpu->i + i);
                     }
-                    cpu->i += OP_X + 1;
+                    // SUPER-CHIP leaves I unmodified
+                    cpu->i += c8->mode == C8_MODE_SCHIP ? 0 : OP_X + 1;
+                    break;
+                case 0x75:
+                    // 0xFX75: store v0 to vx (including vx) in the persistent flag registers
+                    if (c8->mode == C8_MODE_CHIP8)
+                    {
+                        goto illegal_op;
+                    }
+                    memcpy(cpu->rpl, cpu->v, OP_X + 1);
+                    break;
+                case 0x85:
+                    // 0xFX85: fill v0 to vx (including vx) from the persistent flag registers
+                    if (c8->mode == C8_MODE_CHIP8)
+                    {
+                        goto illegal_op;
+                    }
+                    memcpy(cpu->v, cpu->rpl, OP_X + 1);
                     break;
                 default:
                     goto illegal_op;
@@ -274,7 +390,10 @@ bool cpu_step(struct chip8 *c8)
             goto illegal_op;
     }
 
-    decrement_timers(c8);
+    if (c8->timing == C8_TIMING_FIXED)
+    {
+        cpu_decrement_timers(c8);
+    }
     return true;
 
 illegal_op:
@@ -282,6 +401,35 @@ illegal_op:
         return false;
 }
 
+void cpu_clock(struct chip8 *c8, uint16_t op)
+{
+    if (c8->timing == C8_TIMING_VIP)
+    {
+        vip_clock(c8, op);
+    }
+    else
+    {
+        c8->cpu->cycles++;
+    }
+}
+
+void cpu_decrement_timers(struct chip8 *c8)
+{
+    struct c8_cpu *cpu = c8->cpu;
+    if (cpu->timer_delay)
+    {
+        cpu->timer_delay--;
+    }
+    if (cpu->timer_sound)
+    {
+        cpu->timer_sound--;
+        if (cpu->timer_sound == 0)
+        {
+            c8->beep = true;
+        }
+    }
+}
+
 
 static uint16_t pop(struct c8_cpu *cpu)
 {
@@ -298,20 +446,197 @@ static void push(struct c8_cpu *cpu, uint16_t value)
     cpu->sp++;
 }
 
-static void decrement_timers(struct chip8 *c8)
+
+
+static bool exec_extended_sys(struct chip8 *c8, uint16_t op)
 {
-    struct c8_cpu *cpu = c8->cpu;
-    if (cpu->timer_delay)
+    if ((op & 0xF0) == 0xC0)
     {
-        cpu->timer_delay--;
+        // 0x00CN: scroll the display down by N rows
+        display_scroll_down(&c8->display, op & 0xF);
+        c8->draw = true;
+        return true;
     }
-    if (cpu->timer_sound)
+    if ((op & 0xF0) == 0xD0 && c8->mode == C8_MODE_XOCHIP)
     {
-        cpu->timer_sound--;
-        if (cpu->timer_sound == 0)
+        // 0x00DN: scroll the display up by N rows
+        display_scroll_up(&c8->display, op & 0xF);
+        c8->draw = true;
+        return true;
+    }
+
+    switch (op & 0xFF)
+    {
+        case 0xFB:
+            // 0x00FB: scroll the display right by 4 pixels
+            display_scroll_right(&c8->display);
+            break;
+        case 0xFC:
+            // 0x00FC: scroll the display left by 4 pixels
+            display_scroll_left(&c8->display);
+            break;
+        case 0xFD:
+            // 0x00FD: exit the interpreter
+            c8->alive = false;
+            return true;
+        case 0xFE:
+            // 0x00FE: switch to lores mode
+            display_set_hires(&c8->display, false);
+            break;
+        case 0xFF:
+            // 0x00FF: switch to hires mode
+            display_set_hires(&c8->display, true);
+            break;
+        default:
+            return false;
+    }
+    c8->draw = true;
+    return true;
+}
+
+uint8_t cpu_random(struct c8_cpu *cpu)
+{
+    // Marsaglia's xorshift32, the low bits are the weakest so the top byte is returned
+    cpu->rng ^= cpu->rng << 13;
+    cpu->rng ^= cpu->rng >> 17;
+    cpu->rng ^= cpu->rng << 5;
+    return cpu->rng >> 24;
+}
+
+void cpu_draw_sprite(struct chip8 *c8, uint8_t x, uint8_t y, uint8_t height)
+{
+    struct c8_cpu *cpu = c8->cpu;
+    const bool WIDE = height == 0 && c8->mode != C8_MODE_CHIP8;
+    const int ROWS = WIDE ? 16 : height;
+    const int BYTES = WIDE ? ROWS * 2 : ROWS;
+    uint8_t sprite[32];
+    uint16_t addr = cpu->i;
+    bool collision = false;
+
+    // XO-CHIP draws the sprite data for each selected plane back to back, starting at I
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if ((c8->display.planes & (1 << plane)) == 0)
         {
-            c8->beep = true;
+            continue;
+        }
+        for (int i = 0; i < BYTES; i++)
+        {
+            sprite[i] = c8_mem_read8(c8, addr + i);
         }
+        collision |= display_draw(&c8->display, plane, x, y, sprite, ROWS, WIDE);
+        addr += BYTES;
     }
+
+    cpu->v[0xF] = collision ? 1 : 0;
+    c8->draw = true;
 }
 
+static uint16_t skip_len(struct chip8 *c8)
+{
+    // XO-CHIP skips must step over the whole of the 4 byte 0xF000 NNNN instruction
+    if (c8->mode == C8_MODE_XOCHIP && c8_mem_read16(c8, c8->cpu->pc) == 0xF000)
+    {
+        return 2 * C8_INS_LEN;
+    }
+    return C8_INS_LEN;
+}
+
+static void vip_clock(struct chip8 *c8, uint16_t op)
+{
+    // Approximate machine cycles taken by the routines of the VIP interpreter. Every instruction
+    // pays for the fetch and dispatch, skips pay for the extra branch when they are taken.
+    static const uint32_t FETCH = 40;
+    static const uint32_t SKIP = 4;
+    struct c8_cpu *cpu = c8->cpu;
+    const uint8_t VX = cpu->v[(op & 0x0F00) >> 8];
+    const uint8_t VY = cpu->v[(op & 0x00F0) >> 4];
+    const uint8_t NN = op & 0xFF;
+    uint32_t cost;
+
+    switch (op & 0xF000)
+    {
+        case 0x0:
+            cost = op == 0x00E0 ? 24 + 256 * 12 : op == 0x00EE ? 10 : 26;
+            break;
+        case 0x1000:
+            cost = 12;
+            break;
+        case 0x2000:
+            cost = 26;
+            break;
+        case 0x3000:
+            cost = 10 + (VX == NN ? SKIP : 0);
+            break;
+        case 0x4000:
+            cost = 10 + (VX != NN ? SKIP : 0);
+            break;
+        case 0x5000:
+            cost = 14 + (VX == VY ? SKIP : 0);
+            break;
+        case 0x6000:
+            cost = 6;
+            break;
+        case 0x7000:
+            cost = 10;
+            break;
+        case 0x8000:
+            cost = 44;
+            break;
+        case 0x9000:
+            cost = 14 + (VX != VY ? SKIP : 0);
+            break;
+        case 0xA000:
+            cost = 12;
+            break;
+        case 0xB000:
+            // An extra cycle pair when adding v0 carries into the page
+            cost = 22 + (((op & 0xFF) + cpu->v[0]) > 0xFF ? 2 : 0);
+            break;
+        case 0xC000:
+            cost = 36;
+            break;
+        case 0xD000:
+        {
+            // Each row is shifted into place one bit at a time, then XORed into two bytes. On the
+            // VIP a sprite is only drawn after waiting for the display interrupt, so the rest of
+            // the frame is lost and the draw itself is paid from the next one. As in
+            // cpu_draw_sprite, DXY0 is only a 16 row sprite outside CHIP-8 mode.
+            const bool WIDE = (op & 0xF) == 0 && c8->mode != C8_MODE_CHIP8;
+            const uint32_t ROWS = WIDE ? 16 : op & 0xF;
+            cost = 26 + ROWS * (46 + 8 * (VX & 7));
+            if (c8->mode == C8_MODE_CHIP8 && cpu->cycles < C8_VIP_FRAME_CYCLES)
+            {
+                cpu->cycles = C8_VIP_FRAME_CYCLES;
+            }
+            break;
+        }
+        case 0xE000:
+        {
+            const bool PRESSED = c8_key_pressed(c8, VX & 0xF);
+            cost = 14 + (PRESSED == (NN == 0x9E) ? SKIP : 0);
+            break;
+        }
+        default:
+            switch (NN)
+            {
+                case 0x1E:
+                case 0x29:
+                    cost = 16;
+                    break;
+                case 0x33:
+                    // Each digit is found by repeated subtraction
+                    cost = 80 + 16 * (VX / 100 + (VX / 10) % 10 + VX % 10);
+                    break;
+                case 0x55:
+                case 0x65:
+                    cost = 14 + 14 * (((op & 0x0F00) >> 8) + 1);
+                    break;
+                default:
+                    cost = 10;
+                    break;
+            }
+            break;
+    }
+    cpu->cycles += FETCH + cost;
+}
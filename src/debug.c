@@ -0,0 +1,477 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "disasm.h"
+
+static const char *DEBUG_PROMPT = "(c8db) ";
+
+/* Console front end. */
+static bool console_session(struct chip8 *c8);
+static void console_help(void);
+static void console_registers(struct chip8 *c8);
+static void console_stack(struct chip8 *c8);
+static void console_dump(struct chip8 *c8, uint32_t addr, uint32_t count);
+static void console_disasm(struct chip8 *c8, uint32_t addr, uint32_t count);
+
+/* Remote serial protocol front end. */
+static bool remote_session(struct chip8 *c8);
+static bool remote_recv(struct c8_debugger *debugger, char *packet, size_t len);
+static void remote_send(struct c8_debugger *debugger, const char *data);
+static void remote_stop_reply(struct c8_debugger *debugger);
+static bool remote_point(struct chip8 *c8, const char *args, bool insert);
+static void remote_registers(struct chip8 *c8, char *out);
+
+/* Set or clear a flag over a range of addresses, bounded by the address space of the chip8. */
+static void debug_flag(struct chip8 *c8, uint32_t addr, uint32_t count, uint8_t flag, bool set);
+
+bool debug_init(struct c8_debugger *debugger, int port)
+{
+    memset(debugger->flags, 0, sizeof debugger->flags);
+    debugger->stop = true;
+    debugger->steps = 0;
+    debugger->watch_hit = false;
+    debugger->listen_fd = -1;
+    debugger->client_fd = -1;
+    if (port == 0)
+    {
+        return true;
+    }
+
+    debugger->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (debugger->listen_fd < 0)
+    {
+        perror("Failed to create debugger socket");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(debugger->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(debugger->listen_fd, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+            listen(debugger->listen_fd, 1) != 0)
+    {
+        perror("Failed to bind debugger socket");
+        debug_destroy(debugger);
+        return false;
+    }
+
+    printf("Waiting for debugger on 127.0.0.1:%d\n", port);
+    debugger->client_fd = accept(debugger->listen_fd, NULL, NULL);
+    if (debugger->client_fd < 0)
+    {
+        perror("Failed to accept debugger connection");
+        debug_destroy(debugger);
+        return false;
+    }
+
+    return true;
+}
+
+void debug_destroy(struct c8_debugger *debugger)
+{
+    if (debugger->client_fd >= 0)
+    {
+        close(debugger->client_fd);
+        debugger->client_fd = -1;
+    }
+    if (debugger->listen_fd >= 0)
+    {
+        close(debugger->listen_fd);
+        debugger->listen_fd = -1;
+    }
+}
+
+bool debug_break(struct chip8 *c8)
+{
+    struct c8_debugger *debugger = c8->debugger;
+    const bool BREAKPOINT = debugger->flags[c8->cpu->pc] & C8_DEBUG_BREAK;
+    if (debugger->steps > 1 && !BREAKPOINT && !debugger->watch_hit)
+    {
+        debugger->steps--;
+        return true;
+    }
+    debugger->steps = 0;
+
+    return debugger->listen_fd >= 0 ? remote_session(c8) : console_session(c8);
+}
+
+void debug_watch(struct chip8 *c8, uint16_t addr)
+{
+    struct c8_debugger *debugger = c8->debugger;
+    /* Report the first watched write of an instruction, execution stops once it completes. */
+    if ((debugger->flags[addr] & C8_DEBUG_WATCH) && !debugger->watch_hit)
+    {
+        debugger->watch_hit = true;
+        debugger->watch_addr = addr;
+        debugger->stop = true;
+    }
+}
+
+static bool console_session(struct chip8 *c8)
+{
+    struct c8_debugger *debugger = c8->debugger;
+    if (debugger->watch_hit)
+    {
+        printf("Watchpoint hit: write to 0x%04x\n", debugger->watch_addr);
+        debugger->watch_hit = false;
+    }
+    else if (debugger->flags[c8->cpu->pc] & C8_DEBUG_BREAK)
+    {
+        printf("Breakpoint hit\n");
+    }
+    console_disasm(c8, c8->cpu->pc, 1);
+
+    char line[256];
+    char command[16];
+    while (true)
+    {
+        printf("%s", DEBUG_PROMPT);
+        fflush(stdout);
+        if (fgets(line, sizeof line, stdin) == NULL)
+        {
+            return false;
+        }
+
+        char arg1_str[32] = "";
+        char arg2_str[32] = "";
+        int argc = sscanf(line, "%15s %31s %31s", command, arg1_str, arg2_str) - 1;
+        if (argc < 0)
+        {
+            continue;
+        }
+        const unsigned long arg1 = strtoul(arg1_str, NULL, 0);
+        const unsigned long arg2 = strtoul(arg2_str, NULL, 0);
+
+        if (strcmp(command, "c") == 0)
+        {
+            debugger->stop = false;
+            return true;
+        }
+        else if (strcmp(command, "s") == 0)
+        {
+            debugger->stop = true;
+            debugger->steps = argc >= 1 && arg1 > 0 ? arg1 : 1;
+            return true;
+        }
+        else if ((strcmp(command, "b") == 0 || strcmp(command, "w") == 0) && argc >= 1)
+        {
+            const uint8_t FLAG = command[0] == 'b' ? C8_DEBUG_BREAK : C8_DEBUG_WATCH;
+            debug_flag(c8, arg1, argc >= 2 ? arg2 : 1, FLAG, true);
+        }
+        else if (strcmp(command, "d") == 0 && argc >= 1)
+        {
+            debug_flag(c8, arg1, argc >= 2 ? arg2 : 1, C8_DEBUG_BREAK | C8_DEBUG_WATCH, false);
+        }
+        else if (strcmp(command, "r") == 0)
+        {
+            console_registers(c8);
+        }
+        else if (strcmp(command, "bt") == 0)
+        {
+            console_stack(c8);
+        }
+        else if (strcmp(command, "x") == 0 && argc >= 1)
+        {
+            console_dump(c8, arg1, argc >= 2 ? arg2 : 16);
+        }
+        else if (strcmp(command, "l") == 0)
+        {
+            console_disasm(c8, argc >= 1 ? arg1 : c8->cpu->pc, argc >= 2 ? arg2 : 10);
+        }
+        else if (strcmp(command, "q") == 0)
+        {
+            return false;
+        }
+        else
+        {
+            console_help();
+        }
+    }
+}
+
+static void console_help(void)
+{
+    printf("c                 continue\n"
+           "s [n]             step n instructions\n"
+           "b <addr> [len]    set breakpoint\n"
+           "w <addr> [len]    set write watchpoint\n"
+           "d <addr> [len]    delete breakpoints and watchpoints\n"
+           "r                 show registers\n"
+           "bt                show call stack\n"
+           "x <addr> [n]      dump n bytes of memory\n"
+           "l [addr] [n]      disassemble n instructions\n"
+           "q                 quit\n");
+}
+
+static void console_registers(struct chip8 *c8)
+{
+    struct c8_cpu *cpu = c8->cpu;
+    for (int i = 0; i <= 0xF; i++)
+    {
+        printf("V%X:%02x%s", i, cpu->v[i], (i % 8 == 7) ? "\n" : "  ");
+    }
+    printf("PC:%04x  I:%04x  SP:%02x  DT:%02x  ST:%02x\n",
+            cpu->pc, cpu->i, cpu->sp, cpu->timer_delay, cpu->timer_sound);
+}
+
+static void console_stack(struct chip8 *c8)
+{
+    struct c8_cpu *cpu = c8->cpu;
+    printf("#0  %04x\n", cpu->pc);
+    for (int i = cpu->sp - 1; i >= 0; i--)
+    {
+        printf("#%d  %04x\n", cpu->sp - i, cpu->stack[i]);
+    }
+}
+
+static void console_dump(struct chip8 *c8, uint32_t addr, uint32_t count)
+{
+    for (uint32_t i = 0; i < count && addr + i < c8->mem_size; i++)
+    {
+        if (i % 16 == 0)
+        {
+            printf("%s%04x:", i ? "\n" : "", addr + i);
+        }
+        printf(" %02x", c8->memory[addr + i]);
+    }
+    printf("\n");
+}
+
+static void console_disasm(struct chip8 *c8, uint32_t addr, uint32_t count)
+{
+    char text[32];
+    for (uint32_t i = 0; i < count && addr + 1 < c8->mem_size; i++)
+    {
+        const uint16_t OP = (c8->memory[addr] << 8) | c8->memory[addr + 1];
+        const uint16_t NEXT = addr + 3 < c8->mem_size ?
+            (c8->memory[addr + 2] << 8) | c8->memory[addr + 3] : 0;
+        const int LEN = disasm_format(OP, NEXT, c8->mode, text, sizeof text);
+        printf("%c%c %04x: %04x  %s\n", addr == c8->cpu->pc ? '>' : ' ',
+                c8->debugger->flags[addr] & C8_DEBUG_BREAK ? '*' : ' ', addr, OP, text);
+        addr += LEN;
+    }
+}
+
+static bool remote_session(struct chip8 *c8)
+{
+    struct c8_debugger *debugger = c8->debugger;
+    char packet[1024];
+    char reply[1024];
+    remote_stop_reply(debugger);
+    while (remote_recv(debugger, packet, sizeof packet))
+    {
+        unsigned long addr;
+        unsigned long len;
+        switch (packet[0])
+        {
+            case '?':
+                remote_stop_reply(debugger);
+                break;
+            case 'g':
+                remote_registers(c8, reply);
+                remote_send(debugger, reply);
+                break;
+            case 'm':
+                /* Bounds are checked without adding addr and len, which may wrap. */
+                if (sscanf(packet + 1, "%lx,%lx", &addr, &len) != 2 || addr > c8->mem_size ||
+                        len > c8->mem_size - addr || len * 2 >= sizeof reply)
+                {
+                    remote_send(debugger, "E01");
+                    break;
+                }
+                for (unsigned long i = 0; i < len; i++)
+                {
+                    sprintf(&reply[i * 2], "%02x", c8->memory[addr + i]);
+                }
+                reply[len * 2] = '\0';
+                remote_send(debugger, reply);
+                break;
+            case 'M':
+            {
+                /* Written like the program would, so watchpoints fire and compiled code is dropped. */
+                const char *data = strchr(packet, ':');
+                if (sscanf(packet + 1, "%lx,%lx", &addr, &len) != 2 || data == NULL ||
+                        addr < C8_LOAD_ADDR || addr > c8->mem_size ||
+                        len > c8->mem_size - addr || strlen(data + 1) < len * 2)
+                {
+                    remote_send(debugger, "E01");
+                    break;
+                }
+
+                /* Validate the whole payload first, so a bad packet writes nothing. */
+                bool hex = true;
+                for (unsigned long i = 0; i < len * 2; i++)
+                {
+                    hex &= isxdigit((unsigned char)data[1 + i]) != 0;
+                }
+                if (!hex)
+                {
+                    remote_send(debugger, "E01");
+                    break;
+                }
+                for (unsigned long i = 0; i < len; i++)
+                {
+                    unsigned value;
+                    sscanf(data + 1 + i * 2, "%2x", &value);
+                    c8_mem_write8(c8, addr + i, value);
+                }
+                remote_send(debugger, "OK");
+                break;
+            }
+            case 'c':
+                /* A watchpoint hit by an M packet is reported by stopping again at once. */
+                debugger->stop = debugger->watch_hit;
+                return true;
+            case 's':
+                debugger->stop = true;
+                debugger->steps = 1;
+                return true;
+            case 'Z':
+            case 'z':
+                remote_send(debugger, remote_point(c8, packet + 1, packet[0] == 'Z') ? "OK" : "");
+                break;
+            case 'D':
+                memset(debugger->flags, 0, sizeof debugger->flags);
+                debugger->stop = false;
+                remote_send(debugger, "OK");
+                debug_destroy(debugger);
+                return true;
+            case 'k':
+                return false;
+            default:
+                remote_send(debugger, "");
+                break;
+        }
+    }
+
+    /* The client went away, so carry on running without it. */
+    debug_destroy(debugger);
+    memset(debugger->flags, 0, sizeof debugger->flags);
+    debugger->stop = false;
+    return true;
+}
+
+static bool remote_recv(struct c8_debugger *debugger, char *packet, size_t len)
+{
+    char c;
+    size_t pos = 0;
+    bool in_packet = false;
+    while (read(debugger->client_fd, &c, 1) == 1)
+    {
+        if (!in_packet)
+        {
+            in_packet = c == '$';
+            continue;
+        }
+        if (c == '#')
+        {
+            /* Discard the checksum, the transport is already reliable. */
+            char checksum[2];
+            if (read(debugger->client_fd, checksum, 2) != 2 || write(debugger->client_fd, "+", 1) != 1)
+            {
+                return false;
+            }
+            packet[pos] = '\0';
+            return true;
+        }
+        if (pos + 1 < len)
+        {
+            packet[pos++] = c;
+        }
+    }
+    return false;
+}
+
+static void remote_send(struct c8_debugger *debugger, const char *data)
+{
+    uint8_t checksum = 0;
+    for (const char *p = data; *p; p++)
+    {
+        checksum += *p;
+    }
+
+    char frame[1100];
+    int len = snprintf(frame, sizeof frame, "$%s#%02x", data, checksum);
+    if (write(debugger->client_fd, frame, len) != len)
+    {
+        perror("Failed to write to debugger");
+    }
+}
+
+static void remote_stop_reply(struct c8_debugger *debugger)
+{
+    char reply[32];
+    if (debugger->watch_hit)
+    {
+        snprintf(reply, sizeof reply, "T05watch:%x;", debugger->watch_addr);
+        debugger->watch_hit = false;
+    }
+    else
+    {
+        snprintf(reply, sizeof reply, "S05");
+    }
+    remote_send(debugger, reply);
+}
+
+static bool remote_point(struct chip8 *c8, const char *args, bool insert)
+{
+    unsigned type;
+    unsigned long addr;
+    unsigned long len;
+    if (sscanf(args, "%u,%lx,%lx", &type, &addr, &len) != 3)
+    {
+        return false;
+    }
+
+    switch (type)
+    {
+        case 0:
+        case 1:
+            debug_flag(c8, addr, 1, C8_DEBUG_BREAK, insert);
+            return true;
+        case 2:
+            debug_flag(c8, addr, len, C8_DEBUG_WATCH, insert);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void remote_registers(struct chip8 *c8, char *out)
+{
+    struct c8_cpu *cpu = c8->cpu;
+    for (int i = 0; i <= 0xF; i++)
+    {
+        out += sprintf(out, "%02x", cpu->v[i]);
+    }
+    sprintf(out, "%02x%02x%02x%02x%02x%02x%02x", cpu->i & 0xFF, cpu->i >> 8,
+            cpu->pc & 0xFF, cpu->pc >> 8, cpu->sp, cpu->timer_delay, cpu->timer_sound);
+}
+
+static void debug_flag(struct chip8 *c8, uint32_t addr, uint32_t count, uint8_t flag, bool set)
+{
+    for (uint32_t i = 0; i < count && addr + i < c8->mem_size; i++)
+    {
+        if (set)
+        {
+            c8->debugger->flags[addr + i] |= flag;
+        }
+        else
+        {
+            c8->debugger->flags[addr + i] &= ~flag;
+        }
+    }
+}
@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "disasm.h"
+
+/* Program tracing helpers. */
+static bool in_rom(const struct c8_program *program, uint32_t addr);
+static void decode_at(const struct c8_program *program, uint32_t addr, struct c8_ins *ins);
+static void format_at(const struct c8_program *program, uint32_t addr, char *buf, size_t len);
+static uint16_t read16(const struct c8_program *program, uint32_t addr);
+static uint16_t skip_len(const struct c8_program *program, uint32_t addr);
+static void mark_block(struct c8_program *program, uint32_t addr, uint16_t *worklist, size_t *pending);
+static bool build_blocks(struct c8_program *program);
+static void add_succ(const struct c8_program *program, struct c8_block *block, uint32_t addr);
+
+int disasm_format(uint16_t op, uint16_t next, enum c8_mode mode, char *buf, size_t len)
+{
+    const unsigned X   = (op & 0x0F00) >> 8;
+    const unsigned Y   = (op & 0x00F0) >> 4;
+    const unsigned N   = (op & 0x000F) >> 0;
+    const unsigned NN  = (op & 0x00FF) >> 0;
+    const unsigned NNN = (op & 0x0FFF) >> 0;
+    const bool SCHIP = mode != C8_MODE_CHIP8;
+    const bool XOCHIP = mode == C8_MODE_XOCHIP;
+
+    switch (op & 0xF000)
+    {
+        case 0x0000:
+            if (SCHIP && X == 0 && Y == 0xC)
+            {
+                snprintf(buf, len, "SCD %u", N);
+            }
+            else if (XOCHIP && X == 0 && Y == 0xD)
+            {
+                snprintf(buf, len, "SCU %u", N);
+            }
+            else if (SCHIP && op >= 0x00FB && op <= 0x00FF)
+            {
+                static const char *SYS[] = { "SCR", "SCL", "EXIT", "LOW", "HIGH" };
+                snprintf(buf, len, "%s", SYS[op - 0x00FB]);
+            }
+            else if (NN == 0xE0)
+            {
+                snprintf(buf, len, "CLS");
+            }
+            else if (NN == 0xEE)
+            {
+                snprintf(buf, len, "RET");
+            }
+            else
+            {
+                snprintf(buf, len, "SYS 0x%03x", NNN);
+            }
+            break;
+        case 0x1000:
+            snprintf(buf, len, "JP 0x%03x", NNN);
+            break;
+        case 0x2000:
+            snprintf(buf, len, "CALL 0x%03x", NNN);
+            break;
+        case 0x3000:
+            snprintf(buf, len, "SE V%X, 0x%02x", X, NN);
+            break;
+        case 0x4000:
+            snprintf(buf, len, "SNE V%X, 0x%02x", X, NN);
+            break;
+        case 0x5000:
+            if (XOCHIP && N == 0x2)
+            {
+                snprintf(buf, len, "SAVE V%X-V%X", X, Y);
+            }
+            else if (XOCHIP && N == 0x3)
+            {
+                snprintf(buf, len, "LOAD V%X-V%X", X, Y);
+            }
+            else
+            {
+                snprintf(buf, len, "SE V%X, V%X", X, Y);
+            }
+            break;
+        case 0x6000:
+            snprintf(buf, len, "LD V%X, 0x%02x", X, NN);
+            break;
+        case 0x7000:
+            snprintf(buf, len, "ADD V%X, 0x%02x", X, NN);
+            break;
+        case 0x8000:
+        {
+            static const char *ALU[] =
+            {
+                "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                NULL, NULL, NULL, NULL, NULL, NULL, "SHL", NULL
+            };
+            if (ALU[N] == NULL)
+            {
+                snprintf(buf, len, "DW 0x%04x", op);
+            }
+            else
+            {
+                snprintf(buf, len, "%s V%X, V%X", ALU[N], X, Y);
+            }
+            break;
+        }
+        case 0x9000:
+            snprintf(buf, len, "SNE V%X, V%X", X, Y);
+            break;
+        case 0xA000:
+            snprintf(buf, len, "LD I, 0x%03x", NNN);
+            break;
+        case 0xB000:
+            if (mode == C8_MODE_SCHIP)
+            {
+                snprintf(buf, len, "JP V%X, 0x%03x", X, NNN);
+            }
+            else
+            {
+                snprintf(buf, len, "JP V0, 0x%03x", NNN);
+            }
+            break;
+        case 0xC000:
+            snprintf(buf, len, "RND V%X, 0x%02x", X, NN);
+            break;
+        case 0xD000:
+            snprintf(buf, len, "DRW V%X, V%X, %u", X, Y, N);
+            break;
+        case 0xE000:
+            if (NN == 0x9E)
+            {
+                snprintf(buf, len, "SKP V%X", X);
+            }
+            else if (NN == 0xA1)
+            {
+                snprintf(buf, len, "SKNP V%X", X);
+            }
+            else
+            {
+                snprintf(buf, len, "DW 0x%04x", op);
+            }
+            break;
+        case 0xF000:
+            switch (NN)
+            {
+                case 0x00:
+                    if (XOCHIP && X == 0)
+                    {
+                        snprintf(buf, len, "LD I, 0x%04x", next);
+                        return 2 * C8_INS_LEN;
+                    }
+                    snprintf(buf, len, "DW 0x%04x", op);
+                    break;
+                case 0x01:
+                    snprintf(buf, len, XOCHIP ? "PLANE %u" : "DW 0x%04x", XOCHIP ? X : op);
+                    break;
+                case 0x02:
+                    snprintf(buf, len, XOCHIP && X == 0 ? "AUDIO" : "DW 0x%04x", op);
+                    break;
+                case 0x07:
+                    snprintf(buf, len, "LD V%X, DT", X);
+                    break;
+                case 0x0A:
+                    snprintf(buf, len, "LD V%X, K", X);
+                    break;
+                case 0x15:
+                    snprintf(buf, len, "LD DT, V%X", X);
+                    break;
+                case 0x18:
+                    snprintf(buf, len, "LD ST, V%X", X);
+                    break;
+                case 0x1E:
+                    snprintf(buf, len, "ADD I, V%X", X);
+                    break;
+                case 0x29:
+                    snprintf(buf, len, "LD F, V%X", X);
+                    break;
+                case 0x30:
+                    snprintf(buf, len, SCHIP ? "LD HF, V%X" : "DW 0x%04x", SCHIP ? X : op);
+                    break;
+                case 0x33:
+                    snprintf(buf, len, "LD B, V%X", X);
+                    break;
+                case 0x3A:
+                    snprintf(buf, len, XOCHIP ? "PITCH V%X" : "DW 0x%04x", XOCHIP ? X : op);
+                    break;
+                case 0x55:
+                    snprintf(buf, len, "LD [I], V%X", X);
+                    break;
+                case 0x65:
+                    snprintf(buf, len, "LD V%X, [I]", X);
+                    break;
+                case 0x75:
+                    snprintf(buf, len, SCHIP ? "LD R, V%X" : "DW 0x%04x", SCHIP ? X : op);
+                    break;
+                case 0x85:
+                    snprintf(buf, len, SCHIP ? "LD V%X, R" : "DW 0x%04x", SCHIP ? X : op);
+                    break;
+                default:
+                    snprintf(buf, len, "DW 0x%04x", op);
+                    break;
+            }
+            break;
+    }
+
+    return C8_INS_LEN;
+}
+
+void disasm_decode(uint16_t op, uint16_t next, enum c8_mode mode, struct c8_ins *ins)
+{
+    const unsigned X  = (op & 0x0F00) >> 8;
+    const unsigned Y  = (op & 0x00F0) >> 4;
+    const unsigned N  = (op & 0x000F) >> 0;
+    const unsigned NN = (op & 0x00FF) >> 0;
+    const bool SCHIP = mode != C8_MODE_CHIP8;
+    const bool XOCHIP = mode == C8_MODE_XOCHIP;
+
+    ins->op = op;
+    ins->len = C8_INS_LEN;
+    ins->flow = C8_FLOW_NEXT;
+    ins->target = op & 0x0FFF;
+    ins->loads_i = false;
+
+    switch (op & 0xF000)
+    {
+        case 0x0000:
+            if (SCHIP && X == 0 && (Y == 0xC || (XOCHIP && Y == 0xD) || NN >= 0xFB))
+            {
+                ins->flow = op == 0x00FD ? C8_FLOW_HALT : C8_FLOW_NEXT;
+            }
+            else if (NN == 0xEE)
+            {
+                ins->flow = C8_FLOW_RET;
+            }
+            else if (NN != 0xE0)
+            {
+                ins->flow = C8_FLOW_CALL;
+            }
+            break;
+        case 0x1000:
+            ins->flow = C8_FLOW_JUMP;
+            break;
+        case 0x2000:
+            ins->flow = C8_FLOW_CALL;
+            break;
+        case 0x3000:
+        case 0x4000:
+        case 0x9000:
+            ins->flow = C8_FLOW_SKIP;
+            break;
+        case 0x5000:
+            ins->flow = XOCHIP && (N == 0x2 || N == 0x3) ? C8_FLOW_NEXT : C8_FLOW_SKIP;
+            break;
+        case 0x8000:
+            ins->flow = (N <= 0x7 || N == 0xE) ? C8_FLOW_NEXT : C8_FLOW_HALT;
+            break;
+        case 0xA000:
+            ins->loads_i = true;
+            break;
+        case 0xB000:
+            ins->flow = C8_FLOW_INDIRECT;
+            break;
+        case 0xE000:
+            ins->flow = (NN == 0x9E || NN == 0xA1) ? C8_FLOW_SKIP : C8_FLOW_HALT;
+            break;
+        case 0xF000:
+            switch (NN)
+            {
+                case 0x00:
+                    if (XOCHIP && X == 0)
+                    {
+                        ins->len = 2 * C8_INS_LEN;
+                        ins->target = next;
+                        ins->loads_i = true;
+                    }
+                    else
+                    {
+                        ins->flow = C8_FLOW_HALT;
+                    }
+                    break;
+                case 0x01:
+                case 0x3A:
+                    ins->flow = XOCHIP ? C8_FLOW_NEXT : C8_FLOW_HALT;
+                    break;
+                case 0x02:
+                    ins->flow = XOCHIP && X == 0 ? C8_FLOW_NEXT : C8_FLOW_HALT;
+                    break;
+                case 0x30:
+                case 0x75:
+                case 0x85:
+                    ins->flow = SCHIP ? C8_FLOW_NEXT : C8_FLOW_HALT;
+                    break;
+                case 0x07:
+                case 0x0A:
+                case 0x15:
+                case 0x18:
+                case 0x1E:
+                case 0x29:
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                    break;
+                default:
+                    ins->flow = C8_FLOW_HALT;
+                    break;
+            }
+            break;
+    }
+}
+
+bool disasm_load(struct c8_program *program, const uint8_t *rom, size_t len, enum c8_mode mode)
+{
+    const size_t MEM_SIZE = mode == C8_MODE_XOCHIP ? C8_XO_MEM_SIZE : C8_MEM_SIZE;
+    if (len > MEM_SIZE - C8_LOAD_ADDR)
+    {
+        fprintf(stderr, "ROM of %zu bytes exceeds available memory\n", len);
+        return false;
+    }
+
+    program->mode = mode;
+    memset(program->memory, 0, sizeof program->memory);
+    memset(program->map, 0, sizeof program->map);
+    memcpy(&program->memory[C8_LOAD_ADDR], rom, len);
+    program->end = C8_LOAD_ADDR + len;
+    program->blocks = NULL;
+    program->block_count = 0;
+    return true;
+}
+
+bool disasm_trace(struct c8_program *program)
+{
+    /* Every address is pushed at most once, as it is marked as a block before being pushed. */
+    uint16_t *worklist = malloc(C8_XO_MEM_SIZE * sizeof *worklist);
+    if (worklist == NULL)
+    {
+        return false;
+    }
+    size_t pending = 0;
+
+    mark_block(program, C8_LOAD_ADDR, worklist, &pending);
+    while (pending > 0)
+    {
+        uint32_t addr = worklist[--pending];
+        struct c8_ins ins;
+        while (in_rom(program, addr))
+        {
+            if (program->map[addr] & (C8_MAP_CODE | C8_MAP_OPERAND))
+            {
+                /* Joined code that has already been traced, which must start a block. */
+                mark_block(program, addr, worklist, &pending);
+                break;
+            }
+
+            decode_at(program, addr, &ins);
+            program->map[addr] |= C8_MAP_CODE;
+            for (int i = 1; i < ins.len && addr + i < program->end; i++)
+            {
+                program->map[addr + i] |= C8_MAP_OPERAND;
+            }
+            if (ins.loads_i)
+            {
+                program->map[ins.target] |= C8_MAP_DATA_REF;
+            }
+
+            const uint32_t NEXT = addr + ins.len;
+            if (ins.flow == C8_FLOW_NEXT)
+            {
+                addr = NEXT;
+                continue;
+            }
+
+            if (ins.flow == C8_FLOW_JUMP || ins.flow == C8_FLOW_CALL)
+            {
+                mark_block(program, ins.target, worklist, &pending);
+            }
+            if (ins.flow == C8_FLOW_CALL)
+            {
+                mark_block(program, NEXT, worklist, &pending);
+            }
+            if (ins.flow == C8_FLOW_SKIP)
+            {
+                mark_block(program, NEXT, worklist, &pending);
+                mark_block(program, NEXT + skip_len(program, NEXT), worklist, &pending);
+            }
+            break;
+        }
+    }
+    free(worklist);
+
+    return build_blocks(program);
+}
+
+void disasm_free(struct c8_program *program)
+{
+    free(program->blocks);
+    program->blocks = NULL;
+    program->block_count = 0;
+}
+
+void disasm_print(const struct c8_program *program, FILE *out)
+{
+    char text[32];
+    uint32_t addr = C8_LOAD_ADDR;
+    while (addr < program->end)
+    {
+        const uint8_t FLAGS = program->map[addr];
+        if (FLAGS & C8_MAP_CODE)
+        {
+            struct c8_ins ins;
+            decode_at(program, addr, &ins);
+            format_at(program, addr, text, sizeof text);
+            if (FLAGS & C8_MAP_BLOCK)
+            {
+                fprintf(out, "\nblock_%04x:\n", addr);
+            }
+            fprintf(out, "    %04x: %04x  %s\n", addr, ins.op, text);
+            addr += ins.len;
+            continue;
+        }
+
+        /* Emit data up to 8 bytes per line, starting a new line at each referenced address. */
+        if (FLAGS & C8_MAP_DATA_REF)
+        {
+            fprintf(out, "\ndata_%04x:\n", addr);
+        }
+        fprintf(out, "    %04x: DB", addr);
+        int count = 0;
+        do
+        {
+            fprintf(out, " 0x%02x", program->memory[addr]);
+            addr++;
+            count++;
+        } while (count < 8 && addr < program->end &&
+                (program->map[addr] & (C8_MAP_CODE | C8_MAP_OPERAND | C8_MAP_DATA_REF)) == 0);
+        fprintf(out, "\n");
+    }
+}
+
+void disasm_print_dot(const struct c8_program *program, FILE *out)
+{
+    char text[32];
+    fprintf(out, "digraph rom {\n    node [shape=box, fontname=monospace];\n");
+    for (size_t b = 0; b < program->block_count; b++)
+    {
+        const struct c8_block *block = &program->blocks[b];
+        fprintf(out, "    b%04x [label=\"block_%04x%s\\l", block->start, block->start,
+                block->idle ? " (idle)" : "");
+        for (uint32_t addr = block->start; addr < block->end; )
+        {
+            struct c8_ins ins;
+            decode_at(program, addr, &ins);
+            format_at(program, addr, text, sizeof text);
+            fprintf(out, "%04x: %s\\l", addr, text);
+            addr += ins.len;
+        }
+        fprintf(out, "\"];\n");
+
+        for (int s = 0; s < block->succ_count; s++)
+        {
+            const char *label = block->exit == C8_FLOW_SKIP ? (s == 0 ? "no skip" : "skip") : "";
+            fprintf(out, "    b%04x -> b%04x [label=\"%s\"];\n", block->start, block->succ[s], label);
+        }
+        if (block->exit == C8_FLOW_CALL && in_rom(program, block->call))
+        {
+            fprintf(out, "    b%04x -> b%04x [style=dashed, label=\"call\"];\n",
+                    block->start, block->call);
+        }
+    }
+    fprintf(out, "}\n");
+}
+
+static bool in_rom(const struct c8_program *program, uint32_t addr)
+{
+    return addr >= C8_LOAD_ADDR && addr < program->end;
+}
+
+static void decode_at(const struct c8_program *program, uint32_t addr, struct c8_ins *ins)
+{
+    disasm_decode(read16(program, addr), read16(program, addr + 2), program->mode, ins);
+}
+
+static void format_at(const struct c8_program *program, uint32_t addr, char *buf, size_t len)
+{
+    disasm_format(read16(program, addr), read16(program, addr + 2), program->mode, buf, len);
+}
+
+static uint16_t read16(const struct c8_program *program, uint32_t addr)
+{
+    return (program->memory[addr & 0xFFFF] << 8) | program->memory[(addr + 1) & 0xFFFF];
+}
+
+static uint16_t skip_len(const struct c8_program *program, uint32_t addr)
+{
+    /* Mirrors cpu_step, XO-CHIP skips step over the whole 4 byte 0xF000 NNNN instruction. */
+    if (program->mode == C8_MODE_XOCHIP && read16(program, addr) == 0xF000)
+    {
+        return 2 * C8_INS_LEN;
+    }
+    return C8_INS_LEN;
+}
+
+static void mark_block(struct c8_program *program, uint32_t addr, uint16_t *worklist, size_t *pending)
+{
+    if (in_rom(program, addr) && (program->map[addr] & C8_MAP_BLOCK) == 0)
+    {
+        program->map[addr] |= C8_MAP_BLOCK;
+        worklist[(*pending)++] = addr;
+    }
+}
+
+static bool build_blocks(struct c8_program *program)
+{
+    size_t capacity = 0;
+    for (uint32_t addr = C8_LOAD_ADDR; addr < program->end; addr++)
+    {
+        capacity += (program->map[addr] & C8_MAP_BLOCK) ? 1 : 0;
+    }
+    program->blocks = malloc((capacity ? capacity : 1) * sizeof *program->blocks);
+    if (program->blocks == NULL)
+    {
+        return false;
+    }
+
+    for (uint32_t start = C8_LOAD_ADDR; start < program->end; start++)
+    {
+        if ((program->map[start] & (C8_MAP_BLOCK | C8_MAP_CODE)) != (C8_MAP_BLOCK | C8_MAP_CODE))
+        {
+            continue;
+        }
+
+        /* Extend the block until a control flow instruction or the start of another block. */
+        struct c8_block *block = &program->blocks[program->block_count++];
+        struct c8_ins ins;
+        uint32_t addr = start;
+        while (true)
+        {
+            decode_at(program, addr, &ins);
+            addr += ins.len;
+            if (ins.flow != C8_FLOW_NEXT || !in_rom(program, addr) ||
+                    (program->map[addr] & (C8_MAP_BLOCK | C8_MAP_CODE)) != C8_MAP_CODE)
+            {
+                break;
+            }
+        }
+
+        block->start = start;
+        block->end = addr;
+        block->exit = ins.flow;
+        block->succ_count = 0;
+        block->call = ins.target;
+        switch (ins.flow)
+        {
+            case C8_FLOW_NEXT:
+            case C8_FLOW_CALL:
+                add_succ(program, block, addr);
+                break;
+            case C8_FLOW_SKIP:
+                add_succ(program, block, addr);
+                add_succ(program, block, addr + skip_len(program, addr));
+                break;
+            case C8_FLOW_JUMP:
+                add_succ(program, block, ins.target);
+                break;
+            default:
+                break;
+        }
+        block->idle = block->succ_count == 1 && block->succ[0] == block->start &&
+            ins.flow == C8_FLOW_JUMP;
+    }
+    return true;
+}
+
+static void add_succ(const struct c8_program *program, struct c8_block *block, uint32_t addr)
+{
+    if (in_rom(program, addr))
+    {
+        block->succ[block->succ_count++] = addr;
+    }
+}
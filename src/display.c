@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "display.h"
+
+/* XOR a row of up to 16 sprite pixels into a packed row, return true on collision. */
+static bool xor_row(struct c8_display *display, uint64_t *row, int x, uint16_t bits, int width);
+
+void display_init(struct c8_display *display)
+{
+    memset(display->rows, 0, sizeof display->rows);
+    display->hires = false;
+    display->planes = 0x1;
+}
+
+int display_width(const struct c8_display *display)
+{
+    return display->hires ? C8_HIRES_WIDTH : C8_DISPLAY_WIDTH;
+}
+
+int display_height(const struct c8_display *display)
+{
+    return display->hires ? C8_HIRES_HEIGHT : C8_DISPLAY_HEIGHT;
+}
+
+void display_set_hires(struct c8_display *display, bool hires)
+{
+    display->hires = hires;
+    memset(display->rows, 0, sizeof display->rows);
+}
+
+void display_clear(struct c8_display *display)
+{
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->planes & (1 << plane))
+        {
+            memset(display->rows[plane], 0, sizeof display->rows[plane]);
+        }
+    }
+}
+
+bool display_draw(struct c8_display *display, int plane, int x, int y,
+        const uint8_t *sprite, int rows, bool wide)
+{
+    const int WIDTH = display_width(display);
+    const int HEIGHT = display_height(display);
+    bool collision = false;
+
+    x %= WIDTH;
+    y %= HEIGHT;
+    for (int row = 0; row < rows && y + row < HEIGHT; row++)
+    {
+        uint16_t bits = wide ? ((uint16_t)sprite[row * 2] << 8) | sprite[row * 2 + 1] : sprite[row];
+        if (bits != 0)
+        {
+            collision |= xor_row(display, display->rows[plane][y + row], x, bits, wide ? 16 : 8);
+        }
+    }
+    return collision;
+}
+
+void display_scroll_down(struct c8_display *display, int n)
+{
+    const int HEIGHT = display_height(display);
+    n = n > HEIGHT ? HEIGHT : n;
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->planes & (1 << plane))
+        {
+            uint64_t (*rows)[C8_ROW_WORDS] = display->rows[plane];
+            memmove(rows[n], rows[0], (HEIGHT - n) * sizeof rows[0]);
+            memset(rows[0], 0, n * sizeof rows[0]);
+        }
+    }
+}
+
+void display_scroll_up(struct c8_display *display, int n)
+{
+    const int HEIGHT = display_height(display);
+    n = n > HEIGHT ? HEIGHT : n;
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->planes & (1 << plane))
+        {
+            uint64_t (*rows)[C8_ROW_WORDS] = display->rows[plane];
+            memmove(rows[0], rows[n], (HEIGHT - n) * sizeof rows[0]);
+            memset(rows[HEIGHT - n], 0, n * sizeof rows[0]);
+        }
+    }
+}
+
+void display_scroll_left(struct c8_display *display)
+{
+    const int HEIGHT = display_height(display);
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->planes & (1 << plane))
+        {
+            for (int y = 0; y < HEIGHT; y++)
+            {
+                uint64_t *row = display->rows[plane][y];
+                row[0] = (row[0] << 4) | (row[1] >> 60);
+                row[1] <<= 4;
+            }
+        }
+    }
+}
+
+void display_scroll_right(struct c8_display *display)
+{
+    const int HEIGHT = display_height(display);
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->planes & (1 << plane))
+        {
+            for (int y = 0; y < HEIGHT; y++)
+            {
+                uint64_t *row = display->rows[plane][y];
+                /* In lores the second word is off-screen, so pixels shifted into it are dropped. */
+                row[1] = display->hires ? (row[1] >> 4) | (row[0] << 60) : 0;
+                row[0] >>= 4;
+            }
+        }
+    }
+}
+
+uint8_t display_pixel(const struct c8_display *display, int x, int y)
+{
+    const uint64_t MASK = (uint64_t)1 << (63 - (x & 63));
+    uint8_t colour = 0;
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        if (display->rows[plane][y][x >> 6] & MASK)
+        {
+            colour |= 1 << plane;
+        }
+    }
+    return colour;
+}
+
+static bool xor_row(struct c8_display *display, uint64_t *row, int x, uint16_t bits, int width)
+{
+    /* Left-align the sprite bits in a word, then split them across the two words of the row. */
+    const uint64_t SPRITE = (uint64_t)bits << (64 - width);
+    uint64_t mask[C8_ROW_WORDS] = { 0, 0 };
+    if (x < 64)
+    {
+        mask[0] = SPRITE >> x;
+        mask[1] = x > 0 ? SPRITE << (64 - x) : 0;
+    }
+    else
+    {
+        mask[1] = SPRITE >> (x - 64);
+    }
+
+    /* Clip at the right edge of a lores display. */
+    if (!display->hires)
+    {
+        mask[1] = 0;
+    }
+
+    bool collision = ((row[0] & mask[0]) | (row[1] & mask[1])) != 0;
+    row[0] ^= mask[0];
+    row[1] ^= mask[1];
+    return collision;
+}
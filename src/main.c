@@ -1,13 +1,31 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "chip8.h"
 #include "cpu.h"
+#include "debug.h"
+#include "snapshot.h"
+#include "watch.h"
 
 // The system instance
 struct chip8 c8;
 struct c8_cpu cpu;
+struct c8_capture capture;
+struct c8_debugger debugger;
+struct c8_startup startup;
+struct c8_metrics_export metrics_export;
+struct c8_snapshot run_ahead;
+struct c8_shared shared;
+struct c8_watch watch;
+
+/* A rom load running on a background thread while the window is opened. */
+struct rom_loader
+{
+    char *filename;
+    ssize_t result;
+};
 
 void sig_handler(int sig)
 {
@@ -18,11 +36,165 @@ void sig_handler(int sig)
     }
 }
 
+/* Parse a --mode argument, return false if the mode is not recognised. */
+static bool parse_mode(const char *name, enum c8_mode *mode)
+{
+    if (strcmp(name, "chip8") == 0)
+    {
+        *mode = C8_MODE_CHIP8;
+    }
+    else if (strcmp(name, "schip") == 0)
+    {
+        *mode = C8_MODE_SCHIP;
+    }
+    else if (strcmp(name, "xochip") == 0)
+    {
+        *mode = C8_MODE_XOCHIP;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Parse a --timing argument, return false if the timing model is not recognised. */
+static bool parse_timing(const char *name, enum c8_timing *timing)
+{
+    if (strcmp(name, "fixed") == 0)
+    {
+        *timing = C8_TIMING_FIXED;
+    }
+    else if (strcmp(name, "vip") == 0)
+    {
+        *timing = C8_TIMING_VIP;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Loader thread entry point. */
+static int load_rom(void *data)
+{
+    struct rom_loader *loader = data;
+    Uint64 start = SDL_GetPerformanceCounter();
+    loader->result = c8_load(loader->filename, &c8, C8_LOAD_ADDR);
+    if (c8.startup != NULL)
+    {
+        c8.startup->phase_ms[C8_PHASE_LOAD] = c8_startup_ms(start);
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    startup.origin = SDL_GetPerformanceCounter();
+    char *rom = NULL;
+    char *capture_file = NULL;
+    char *shared_name = NULL;
+    bool debug = false;
+    bool startup_report = false;
+    bool latency_report = false;
+    bool ahead = false;
+    bool watching = false;
+    enum c8_watch_restore restore = C8_RESTORE_RESET;
+    char *snapshot_file = NULL;
+    char *metrics_file = NULL;
+    char *metrics_socket = NULL;
+    int metrics_interval = 10;
+    int debug_port = 0;
+    enum c8_mode mode = C8_MODE_CHIP8;
+    enum c8_timing timing = C8_TIMING_FIXED;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+        {
+            if (!parse_mode(argv[++i], &mode))
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc)
+        {
+            if (!parse_timing(argv[++i], &timing))
+            {
+                fprintf(stderr, "Unknown timing '%s'\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            capture_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+        {
+            shared_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+        {
+            metrics_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc)
+        {
+            metrics_socket = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc)
+        {
+            metrics_interval = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--startup-report") == 0)
+        {
+            startup_report = true;
+        }
+        else if (strcmp(argv[i], "--latency-report") == 0)
+        {
+            latency_report = true;
+        }
+        else if (strcmp(argv[i], "--run-ahead") == 0)
+        {
+            ahead = true;
+        }
+        else if (strcmp(argv[i], "--watch") == 0)
+        {
+            watching = true;
+        }
+        else if (strcmp(argv[i], "--watch-keep") == 0)
+        {
+            watching = true;
+            restore = C8_RESTORE_STATE;
+        }
+        else if (strcmp(argv[i], "--watch-snapshot") == 0 && i + 1 < argc)
+        {
+            watching = true;
+            restore = C8_RESTORE_SNAPSHOT;
+            snapshot_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--debug") == 0)
+        {
+            debug = true;
+        }
+        else if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc)
+        {
+            debug = true;
+            debug_port = atoi(argv[++i]);
+        }
+        else
+        {
+            rom = argv[i];
+        }
+    }
+
+    if (rom == NULL)
     {
-        fprintf(stderr, "Usage: %s <romfile>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--mode chip8|schip|xochip] [--timing fixed|vip] [--capture <file>] [--shm <name>]\n"
+                "       [--debug | --gdb <port>] [--startup-report] [--latency-report] [--run-ahead]\n"
+                "       [--watch | --watch-keep | --watch-snapshot <file>]\n"
+                "       [--metrics <file>] [--metrics-socket <path>] [--metrics-interval <secs>] <romfile>\n",
+                argv[0]);
         exit(EXIT_FAILURE);
     }
     else
@@ -33,22 +205,104 @@ int main(int argc, char *argv[])
             exit(EXIT_FAILURE);
         }
 
+        Uint64 start = SDL_GetPerformanceCounter();
         if (!c8_init(&c8, &cpu))
         {
             fprintf(stderr, "Failed to init CHIP-8 system\n");
             exit(EXIT_FAILURE);
         }
+        c8.startup = startup_report ? &startup : NULL;
+        c8.timing = timing;
+        c8.run_ahead = ahead ? &run_ahead : NULL;
+        c8.latency_report = latency_report;
+
+        if (!c8_set_mode(&c8, mode))
+        {
+            fprintf(stderr, "Failed to select CHIP-8 mode\n");
+            exit(EXIT_FAILURE);
+        }
+        startup.phase_ms[C8_PHASE_INIT] = c8_startup_ms(start);
+
+        /* Read the rom on a separate thread while the window is opened on this one. */
+        struct rom_loader loader = { .filename = rom, .result = -1 };
+        SDL_Thread *loader_thread = SDL_CreateThread(load_rom, "c8_load", &loader);
+        if (loader_thread == NULL)
+        {
+            load_rom(&loader);
+        }
+
+        if (!c8_open(&c8))
+        {
+            fprintf(stderr, "Failed to open CHIP-8 window\n");
+            exit(EXIT_FAILURE);
+        }
 
-        if (c8_load(argv[1], &c8, C8_LOAD_ADDR) == -1)
+        SDL_WaitThread(loader_thread, NULL);
+        if (loader.result == -1)
         {
-            fprintf(stderr, "Failed to load '%s'\n", argv[1]);
+            fprintf(stderr, "Failed to load '%s'\n", rom);
             exit(EXIT_FAILURE);
         }
+
+        if (capture_file != NULL)
+        {
+            if (!capture_open(&capture, capture_file))
+            {
+                fprintf(stderr, "Failed to start capture to '%s'\n", capture_file);
+                exit(EXIT_FAILURE);
+            }
+            c8.capture = &capture;
+        }
+
+        if (shared_name != NULL)
+        {
+            if (!shared_open(&shared, shared_name))
+            {
+                fprintf(stderr, "Failed to export state to '%s'\n", shared_name);
+                exit(EXIT_FAILURE);
+            }
+            c8.shared = &shared;
+        }
+
+        if (watching)
+        {
+            if (!watch_open(&watch, rom, restore, snapshot_file))
+            {
+                fprintf(stderr, "Failed to watch '%s'\n", rom);
+                exit(EXIT_FAILURE);
+            }
+            c8.watch = &watch;
+        }
+        if (metrics_file != NULL || metrics_socket != NULL)
+        {
+            if (!metrics_export_open(&metrics_export, metrics_file, metrics_socket,
+                        (metrics_interval > 0 ? metrics_interval : 1) * 1000))
+            {
+                fprintf(stderr, "Failed to start metrics export\n");
+                exit(EXIT_FAILURE);
+            }
+            c8.metrics_export = &metrics_export;
+        }
+
+        if (debug)
+        {
+            if (!debug_init(&debugger, debug_port))
+            {
+                fprintf(stderr, "Failed to start debugger\n");
+                exit(EXIT_FAILURE);
+            }
+            c8.debugger = &debugger;
+        }
+        if (debug && ahead)
+        {
+            fprintf(stderr, "Run-ahead is disabled while debugging\n");
+        }
     }
 
     if (c8_run(&c8, C8_LOAD_ADDR) != 0)
     {
         fprintf(stderr, "CHIP-8 terminated unexpectedly\n");
+        c8_destroy(&c8);
         return EXIT_FAILURE;
     }
     
@@ -0,0 +1,305 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+static const char *HIST_NAMES[C8_HIST_COUNT] =
+{
+    "c8_frame_time_seconds",
+    "c8_draw_time_seconds",
+    "c8_audio_block_seconds",
+    "c8_input_block_seconds",
+    "c8_input_latency_seconds"
+};
+
+static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+/* Map a value to its bucket, and a bucket back to the lowest value it holds. */
+static int bucket_index(uint32_t value);
+static uint32_t bucket_value(int index);
+
+/* Render a snapshot and publish it to the file and socket clients. */
+static void metrics_export_dump(struct c8_metrics_export *exporter, const struct c8_metrics *metrics);
+
+/* Socket server thread entry point. */
+static int metrics_serve(void *data);
+
+void metrics_init(struct c8_metrics *metrics)
+{
+    memset(metrics, 0, sizeof *metrics);
+}
+
+void metrics_record(struct c8_histogram *hist, uint32_t value)
+{
+    hist->buckets[bucket_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+    hist->max = value > hist->max ? value : hist->max;
+}
+
+uint32_t metrics_percentile(const struct c8_histogram *hist, double quantile)
+{
+    const uint64_t RANK = (uint64_t)(quantile * hist->count + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < C8_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= RANK && seen > 0)
+        {
+            const uint32_t VALUE = bucket_value(i);
+            return VALUE > hist->max ? hist->max : VALUE;
+        }
+    }
+    return hist->max;
+}
+
+uint32_t metrics_elapsed_us(Uint64 since)
+{
+    return (SDL_GetPerformanceCounter() - since) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+int metrics_format(const struct c8_metrics *metrics, double ips, char *buf, size_t len)
+{
+    const struct
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        double value;
+    } SCALARS[] =
+    {
+        { "c8_instructions_total", "counter", "Instructions executed.", metrics->instructions },
+        { "c8_frames_total", "counter", "Frames presented.", metrics->frames },
+        { "c8_draw_calls_total", "counter", "Framebuffer renders.", metrics->draw_calls },
+        { "c8_overrun_frames_total", "counter", "Frames exceeding their time budget.", metrics->overruns },
+        { "c8_audio_blocked_seconds_total", "counter", "Time blocked in audio.",
+            metrics->audio_blocked_us / 1e6 },
+        { "c8_input_blocked_seconds_total", "counter", "Time blocked awaiting input.",
+            metrics->input_blocked_us / 1e6 },
+        { "c8_instructions_per_second", "gauge", "Emulation rate over the last interval.", ips }
+    };
+
+    int written = 0;
+    for (int i = 0; i < sizeof SCALARS / sizeof SCALARS[0]; i++)
+    {
+        written += snprintf(buf + written, written < len ? len - written : 0,
+                "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", SCALARS[i].name, SCALARS[i].help,
+                SCALARS[i].name, SCALARS[i].type, SCALARS[i].name, SCALARS[i].value);
+    }
+
+    for (int h = 0; h < C8_HIST_COUNT; h++)
+    {
+        const struct c8_histogram *hist = &metrics->hist[h];
+        written += snprintf(buf + written, written < len ? len - written : 0,
+                "# TYPE %s summary\n", HIST_NAMES[h]);
+        for (int q = 0; q < sizeof QUANTILES / sizeof QUANTILES[0]; q++)
+        {
+            written += snprintf(buf + written, written < len ? len - written : 0,
+                    "%s{quantile=\"%g\"} %.6f\n", HIST_NAMES[h], QUANTILES[q],
+                    metrics_percentile(hist, QUANTILES[q]) / 1e6);
+        }
+        written += snprintf(buf + written, written < len ? len - written : 0,
+                "%s_sum %.6f\n%s_count %llu\n", HIST_NAMES[h], hist->sum / 1e6,
+                HIST_NAMES[h], (unsigned long long)hist->count);
+    }
+    return written;
+}
+
+bool metrics_export_open(struct c8_metrics_export *exporter, const char *file, const char *socket_path,
+        Uint32 interval_ms)
+{
+    exporter->file = file;
+    exporter->interval_ms = interval_ms;
+    exporter->last_dump = SDL_GetTicks();
+    exporter->next_dump = exporter->last_dump + interval_ms;
+    exporter->last_instructions = 0;
+    exporter->snapshot[0] = '\0';
+    exporter->socket_path = NULL;
+    exporter->listen_fd = -1;
+    exporter->server = NULL;
+    SDL_AtomicSet(&exporter->running, 1);
+
+    exporter->lock = SDL_CreateMutex();
+    if (exporter->lock == NULL)
+    {
+        fprintf(stderr, "Failed to create metrics lock: %s\n", SDL_GetError());
+        return false;
+    }
+    if (socket_path == NULL)
+    {
+        return true;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof addr.sun_path - 1);
+    unlink(socket_path);
+
+    exporter->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (exporter->listen_fd < 0 || bind(exporter->listen_fd, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+            listen(exporter->listen_fd, 4) != 0)
+    {
+        perror("Failed to open metrics socket");
+        goto fail;
+    }
+    exporter->socket_path = socket_path;
+
+    exporter->server = SDL_CreateThread(metrics_serve, "c8_metrics", exporter);
+    if (exporter->server == NULL)
+    {
+        fprintf(stderr, "Failed to create metrics thread: %s\n", SDL_GetError());
+        goto fail;
+    }
+    return true;
+
+fail:
+    /* Undo whatever was set up, the caller never closes a failed exporter. */
+    if (exporter->listen_fd >= 0)
+    {
+        close(exporter->listen_fd);
+        exporter->listen_fd = -1;
+    }
+    if (exporter->socket_path != NULL)
+    {
+        unlink(exporter->socket_path);
+        exporter->socket_path = NULL;
+    }
+    SDL_DestroyMutex(exporter->lock);
+    exporter->lock = NULL;
+    return false;
+}
+
+void metrics_export_tick(struct c8_metrics_export *exporter, const struct c8_metrics *metrics)
+{
+    if ((Sint32)(SDL_GetTicks() - exporter->next_dump) >= 0)
+    {
+        metrics_export_dump(exporter, metrics);
+    }
+}
+
+void metrics_export_close(struct c8_metrics_export *exporter, const struct c8_metrics *metrics)
+{
+    metrics_export_dump(exporter, metrics);
+    SDL_AtomicSet(&exporter->running, 0);
+    if (exporter->listen_fd >= 0)
+    {
+        /* Wake the server from accept. */
+        shutdown(exporter->listen_fd, SHUT_RDWR);
+        SDL_WaitThread(exporter->server, NULL);
+        close(exporter->listen_fd);
+    }
+    if (exporter->socket_path != NULL)
+    {
+        unlink(exporter->socket_path);
+    }
+    SDL_DestroyMutex(exporter->lock);
+}
+
+static int bucket_index(uint32_t value)
+{
+    if (value < C8_HIST_SUB_COUNT)
+    {
+        return value;
+    }
+    int msb = 31;
+    while ((value & (1u << msb)) == 0)
+    {
+        msb--;
+    }
+    const int SHIFT = msb - C8_HIST_SUB_BITS;
+    return (SHIFT + 1) * C8_HIST_SUB_COUNT + ((value >> SHIFT) & (C8_HIST_SUB_COUNT - 1));
+}
+
+static uint32_t bucket_value(int index)
+{
+    if (index < C8_HIST_SUB_COUNT)
+    {
+        return index;
+    }
+    const int SHIFT = index / C8_HIST_SUB_COUNT - 1;
+    return (uint32_t)(C8_HIST_SUB_COUNT + index % C8_HIST_SUB_COUNT) << SHIFT;
+}
+
+static void metrics_export_dump(struct c8_metrics_export *exporter, const struct c8_metrics *metrics)
+{
+    const Uint32 NOW = SDL_GetTicks();
+    const Uint32 ELAPSED = NOW - exporter->last_dump;
+    const double IPS = ELAPSED ? (metrics->instructions - exporter->last_instructions) * 1000.0 / ELAPSED : 0;
+    exporter->last_dump = NOW;
+    exporter->next_dump = NOW + exporter->interval_ms;
+    exporter->last_instructions = metrics->instructions;
+
+    SDL_LockMutex(exporter->lock);
+    metrics_format(metrics, IPS, exporter->snapshot, sizeof exporter->snapshot);
+    SDL_UnlockMutex(exporter->lock);
+
+    if (exporter->file != NULL)
+    {
+        /* Write then rename, so readers never see a partial file. */
+        char tmp[4096];
+        snprintf(tmp, sizeof tmp, "%s.tmp", exporter->file);
+        FILE *f = fopen(tmp, "w");
+        if (f == NULL)
+        {
+            perror("Failed to write metrics");
+            return;
+        }
+        const bool WRITTEN = fputs(exporter->snapshot, f) != EOF;
+        if (fclose(f) != 0 || !WRITTEN || rename(tmp, exporter->file) != 0)
+        {
+            perror("Failed to write metrics");
+            unlink(tmp);
+        }
+    }
+}
+
+static int metrics_serve(void *data)
+{
+    struct c8_metrics_export *exporter = data;
+    while (SDL_AtomicGet(&exporter->running))
+    {
+        int client = accept(exporter->listen_fd, NULL, NULL);
+        if (client < 0 && (errno == EINTR || errno == ECONNABORTED))
+        {
+            continue;
+        }
+        if (client < 0 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+                    errno == ENOMEM))
+        {
+            /* Out of descriptors or memory for now, so wait for some to be released. */
+            SDL_Delay(100);
+            continue;
+        }
+        if (client < 0)
+        {
+            /* Closing the socket ends the server through here, anything else is a real error. */
+            if (SDL_AtomicGet(&exporter->running))
+            {
+                perror("Failed to accept metrics client");
+            }
+            break;
+        }
+
+        /* Copy the snapshot so a slow client never holds up the emulator thread. */
+        char snapshot[sizeof exporter->snapshot];
+        SDL_LockMutex(exporter->lock);
+        memcpy(snapshot, exporter->snapshot, sizeof snapshot);
+        SDL_UnlockMutex(exporter->lock);
+
+        const size_t LEN = strnlen(snapshot, sizeof snapshot);
+        /* A client that hangs up early must not raise SIGPIPE and end the emulator. */
+        if (send(client, snapshot, LEN, MSG_NOSIGNAL) != (ssize_t)LEN)
+        {
+            perror("Failed to write metrics to client");
+        }
+        close(client);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "shared.h"
+
+bool shared_open(struct c8_shared *shared, const char *name)
+{
+    snprintf(shared->name, sizeof shared->name, "%s", name);
+    shm_unlink(shared->name);
+
+    const int FD = shm_open(shared->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (FD < 0)
+    {
+        perror("Failed to create shared memory");
+        return false;
+    }
+    if (ftruncate(FD, sizeof *shared->segment) != 0)
+    {
+        perror("Failed to size shared memory");
+        close(FD);
+        shm_unlink(shared->name);
+        return false;
+    }
+
+    shared->segment = mmap(NULL, sizeof *shared->segment, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+    close(FD);
+    if (shared->segment == MAP_FAILED)
+    {
+        perror("Failed to map shared memory");
+        shm_unlink(shared->name);
+        return false;
+    }
+
+    /* The segment is zero filled, so the sequence starts even and no keys are pending. */
+    shared->segment->magic = C8_SHARED_MAGIC;
+    shared->segment->version = C8_SHARED_VERSION;
+    shared->segment->size = sizeof *shared->segment;
+    shared->key_sequence = 0;
+    return true;
+}
+
+void shared_input(struct c8_shared *shared, struct chip8 *c8)
+{
+    struct c8_shared_segment *segment = shared->segment;
+    const int SEQUENCE = SDL_AtomicGet(&segment->key_sequence);
+    if (SEQUENCE == shared->key_sequence)
+    {
+        return;
+    }
+    SDL_MemoryBarrierAcquire();
+    for (int key = 0; key < 16; key++)
+    {
+        c8->keyboard[key] = segment->keys[key] != 0;
+    }
+    shared->key_sequence = SEQUENCE;
+}
+
+void shared_publish(struct c8_shared *shared, struct chip8 *c8, uint32_t frame)
+{
+    struct c8_shared_segment *segment = shared->segment;
+    const struct c8_cpu *cpu = c8->cpu;
+
+    /* Only this thread writes the sequence, so a plain increment to odd opens the write. */
+    const int SEQUENCE = SDL_AtomicGet(&segment->sequence);
+    SDL_AtomicSet(&segment->sequence, SEQUENCE + 1);
+    SDL_MemoryBarrierRelease();
+
+    segment->frame = frame;
+    segment->mode = c8->mode;
+    segment->hires = c8->display.hires;
+    segment->planes = c8->display.planes;
+    segment->sp = cpu->sp;
+    memcpy(segment->v, cpu->v, sizeof segment->v);
+    segment->i = cpu->i;
+    segment->pc = cpu->pc;
+    memcpy(segment->stack, cpu->stack, sizeof segment->stack);
+    segment->timer_delay = cpu->timer_delay;
+    segment->timer_sound = cpu->timer_sound;
+    for (int key = 0; key < 16; key++)
+    {
+        segment->keyboard[key] = c8->keyboard[key];
+    }
+    memcpy(segment->rows, c8->display.rows, sizeof segment->rows);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&segment->sequence, SEQUENCE + 2);
+}
+
+void shared_close(struct c8_shared *shared)
+{
+    munmap(shared->segment, sizeof *shared->segment);
+    shm_unlink(shared->name);
+}
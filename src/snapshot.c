@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+/* 'C8SN', then the size of the structure, which changes with any change to its layout. */
+static const uint32_t SNAPSHOT_MAGIC = 0x4e533843;
+
+/* The machine state preceding the memory of a snapshot, which is always written in full. */
+#define SNAPSHOT_STATE_SIZE offsetof(struct c8_snapshot, memory)
+
+void snapshot_save(struct chip8 *c8, struct c8_snapshot *snapshot)
+{
+    snapshot->cpu = *c8->cpu;
+    snapshot->display = c8->display;
+    memcpy(snapshot->audio_pattern, c8->audio_pattern, sizeof snapshot->audio_pattern);
+    snapshot->pitch = c8->pitch;
+    snapshot->beep = c8->beep;
+    snapshot->draw = c8->draw;
+
+    /* Only the active address space is copied, 4 KB unless XO-CHIP mode is enabled. */
+    snapshot->mem_size = c8->mem_size;
+    memcpy(snapshot->memory, c8->memory, c8->mem_size);
+}
+
+bool snapshot_restore(struct chip8 *c8, const struct c8_snapshot *snapshot)
+{
+    if (snapshot->mem_size != c8->mem_size)
+    {
+        fprintf(stderr, "Snapshot address space of %zu bytes does not match %zu\n",
+                snapshot->mem_size, c8->mem_size);
+        return false;
+    }
+
+    *c8->cpu = snapshot->cpu;
+    c8->display = snapshot->display;
+    memcpy(c8->audio_pattern, snapshot->audio_pattern, sizeof c8->audio_pattern);
+    c8->pitch = snapshot->pitch;
+    c8->beep = snapshot->beep;
+    c8->draw = snapshot->draw;
+    memcpy(c8->memory, snapshot->memory, snapshot->mem_size);
+    return true;
+}
+
+bool snapshot_write(const struct c8_snapshot *snapshot, const char *path)
+{
+    const uint32_t HEADER[2] = { SNAPSHOT_MAGIC, sizeof *snapshot };
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    /* Only the active address space is written. */
+    bool ok = fwrite(HEADER, sizeof HEADER, 1, f) == 1 &&
+        fwrite(snapshot, SNAPSHOT_STATE_SIZE, 1, f) == 1 &&
+        fwrite(snapshot->memory, snapshot->mem_size, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write snapshot '%s'\n", path);
+    }
+    return ok;
+}
+
+bool snapshot_read(struct c8_snapshot *snapshot, const char *path)
+{
+    uint32_t header[2];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    bool ok = fread(header, sizeof header, 1, f) == 1 && header[0] == SNAPSHOT_MAGIC &&
+        header[1] == sizeof *snapshot && fread(snapshot, SNAPSHOT_STATE_SIZE, 1, f) == 1 &&
+        snapshot->mem_size <= sizeof snapshot->memory &&
+        fread(snapshot->memory, snapshot->mem_size, 1, f) == 1;
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "'%s' is not a snapshot from this build\n", path);
+    }
+    return ok;
+}
@@ -0,0 +1,192 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "watch.h"
+
+/* Watcher thread entry point, blocks on inotify until the watch is closed. */
+static int watch_thread(void *data);
+
+bool watch_open(struct c8_watch *watch, char *rom, enum c8_watch_restore restore,
+        const char *snapshot_file)
+{
+    watch->rom = rom;
+    watch->restore = restore;
+    watch->snapshot_file = snapshot_file;
+    watch->fd = -1;
+    watch->wd = -1;
+    watch->thread = NULL;
+    SDL_AtomicSet(&watch->pending, 0);
+    SDL_AtomicSet(&watch->running, 1);
+    watch->reload = false;
+
+    /* The directory is watched rather than the file, so a ROM replaced by a rename is still seen. */
+    snprintf(watch->dir, sizeof watch->dir, "%s", rom);
+    char *slash = strrchr(watch->dir, '/');
+    if (slash == NULL)
+    {
+        watch->name = rom;
+        snprintf(watch->dir, sizeof watch->dir, ".");
+    }
+    else
+    {
+        watch->name = rom + (slash - watch->dir) + 1;
+        slash[slash == watch->dir ? 1 : 0] = '\0';
+    }
+
+    watch->event = SDL_RegisterEvents(1);
+    if (watch->event == (Uint32)-1)
+    {
+        fprintf(stderr, "Failed to register watch event: %s\n", SDL_GetError());
+        return false;
+    }
+
+    watch->fd = inotify_init1(IN_CLOEXEC);
+    if (watch->fd < 0)
+    {
+        perror("Failed to start inotify");
+        return false;
+    }
+    watch->wd = inotify_add_watch(watch->fd, watch->dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch->wd < 0)
+    {
+        perror(watch->dir);
+        return false;
+    }
+
+    watch->thread = SDL_CreateThread(watch_thread, "c8_watch", watch);
+    if (watch->thread == NULL)
+    {
+        fprintf(stderr, "Failed to create watch thread: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void watch_reload(struct c8_watch *watch, struct chip8 *c8)
+{
+    /* Cleared first, so a change made while reloading queues another reload. */
+    watch->reload = false;
+    SDL_AtomicSet(&watch->pending, 0);
+
+    snapshot_save(c8, &watch->previous);
+    memset(&c8->memory[C8_LOAD_ADDR], 0, c8->mem_size - C8_LOAD_ADDR);
+    if (c8_load(watch->rom, c8, C8_LOAD_ADDR) < 0)
+    {
+        fprintf(stderr, "Failed to reload '%s', continuing with the previous ROM\n", watch->rom);
+        snapshot_restore(c8, &watch->previous);
+        return;
+    }
+
+    const struct c8_snapshot *from = NULL;
+    if (watch->restore == C8_RESTORE_STATE)
+    {
+        from = &watch->previous;
+    }
+    else if (watch->restore == C8_RESTORE_SNAPSHOT && snapshot_read(&watch->saved, watch->snapshot_file))
+    {
+        if (watch->saved.mem_size == c8->mem_size)
+        {
+            from = &watch->saved;
+        }
+        else
+        {
+            fprintf(stderr, "Snapshot '%s' is for another mode\n", watch->snapshot_file);
+        }
+    }
+
+    /* Memory always comes from the new ROM, only the machine state is carried over. */
+    if (from != NULL)
+    {
+        *c8->cpu = from->cpu;
+        c8->display = from->display;
+        memcpy(c8->audio_pattern, from->audio_pattern, sizeof c8->audio_pattern);
+        c8->pitch = from->pitch;
+    }
+    else
+    {
+        cpu_init(c8->cpu);
+        c8->cpu->pc = C8_LOAD_ADDR;
+        display_init(&c8->display);
+        memset(c8->audio_pattern, 0, sizeof c8->audio_pattern);
+        c8->pitch = 64;
+    }
+    c8->beep = false;
+    c8->draw = true;
+    printf("CHIP-8 Reload %s\n", watch->rom);
+}
+
+void watch_save(struct c8_watch *watch, struct chip8 *c8)
+{
+    if (watch->restore != C8_RESTORE_SNAPSHOT)
+    {
+        return;
+    }
+    snapshot_save(c8, &watch->saved);
+    if (snapshot_write(&watch->saved, watch->snapshot_file))
+    {
+        printf("CHIP-8 Snapshot %s\n", watch->snapshot_file);
+    }
+}
+
+void watch_close(struct c8_watch *watch)
+{
+    SDL_AtomicSet(&watch->running, 0);
+    if (watch->thread != NULL)
+    {
+        /* Removing the watch queues an IN_IGNORED event, waking the thread from its read. */
+        inotify_rm_watch(watch->fd, watch->wd);
+        SDL_WaitThread(watch->thread, NULL);
+    }
+    if (watch->fd >= 0)
+    {
+        close(watch->fd);
+    }
+}
+
+static int watch_thread(void *data)
+{
+    struct c8_watch *watch = data;
+    union
+    {
+        struct inotify_event event;
+        char bytes[4096];
+    } buf;
+
+    while (SDL_AtomicGet(&watch->running))
+    {
+        const ssize_t LEN = read(watch->fd, buf.bytes, sizeof buf.bytes);
+        if (LEN < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (LEN <= 0)
+        {
+            perror("Failed to read inotify events");
+            break;
+        }
+
+        bool changed = false;
+        for (ssize_t offset = 0; offset < LEN; )
+        {
+            const struct inotify_event *event = (const struct inotify_event *)&buf.bytes[offset];
+            changed |= event->len > 0 && strcmp(event->name, watch->name) == 0;
+            offset += sizeof *event + event->len;
+        }
+
+        /* A build may write the ROM several times in a burst, which only needs one reload. */
+        if (changed && SDL_AtomicCAS(&watch->pending, 0, 1))
+        {
+            SDL_Event event;
+            memset(&event, 0, sizeof event);
+            event.type = watch->event;
+            SDL_PushEvent(&event);
+        }
+    }
+    return 0;
+}
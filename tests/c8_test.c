@@ -0,0 +1,621 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "shared.h"
+
+/*
+ * Golden-output conformance harness.
+ *
+ * Each line of the manifest names a test rom, the mode and timing to run it with, a number of 60
+ * Hz frames, scripted key input and the expected hash. Roms are run headless, without a window or
+ * audio, and the hash covers the registers, timers, memory and framebuffer once the last frame has
+ * run, plus the framebuffer after every Nth frame when an interval is given. Tests are shared
+ * between a pool of worker threads, one per CPU unless -j is given.
+ *
+ * Roms may be binary .ch8 files, or .hex sources listing hex bytes or words with '#' comments, in
+ * which an 'addr:' label moves the load position forward so code and data can be placed exactly.
+ *
+ * An input script prefixed with 'shm:' is written to a shared-memory segment during each frame,
+ * as a client would, rather than to the keyboard, so the keys only reach the machine through the
+ * same path as the run loop: at the start of the next frame, or while FX0A waits.
+ *
+ * With -u the hashes in the manifest are rewritten with the values produced, and with -v the
+ * final state of each test is printed, so new goldens can be checked by eye before committing.
+ */
+
+#define MAX_TESTS       256
+#define MAX_LINES       1024
+#define MAX_EVENTS      32
+#define HASH_DIGITS     16
+
+static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+/* A scripted key press or release, applied before the given frame runs. */
+struct key_event
+{
+    uint32_t frame;
+    uint8_t key;
+    bool down;
+};
+
+struct test_case
+{
+    char name[32];
+    char rom[512];
+    enum c8_mode mode;
+    enum c8_timing timing;
+    uint32_t frames;
+    uint32_t every;
+    struct key_event events[MAX_EVENTS];
+    int event_count;
+    bool shared;
+    uint64_t expected;
+
+    /* Position of the expected hash in the manifest, rewritten by -u. */
+    int line;
+    size_t hash_offset;
+
+    /* Results, written by the worker that ran the test. */
+    uint64_t actual;
+    bool ran;
+};
+
+struct job_queue
+{
+    struct test_case *tests;
+    int count;
+    SDL_atomic_t next;
+    bool verbose;
+};
+
+/* Parse the manifest, return the number of tests read or -1 on error. */
+static int read_manifest(const char *path, char lines[][512], int *line_count, struct test_case *tests);
+
+/* Parse a scripted input list such as "0:+9,3:+4,5:-4" or "shm:0:+5", or "-" for none. */
+static bool parse_input(const char *script, struct test_case *test);
+
+/* Load a .hex or .ch8 rom, return true on success. */
+static bool load_rom(struct chip8 *c8, const char *path);
+
+/* Worker thread entry point, runs tests until the queue is exhausted. */
+static int worker(void *data);
+
+/* Run a single test, recording its hash. */
+static void run(struct test_case *test, bool verbose);
+
+/* Hashing of machine state, independent of host byte order and struct layout. */
+static uint64_t hash_bytes(uint64_t hash, const uint8_t *data, size_t len);
+static uint64_t hash_word(uint64_t hash, uint64_t value, int bytes);
+static uint64_t hash_display(uint64_t hash, const struct c8_display *display);
+static uint64_t hash_state(uint64_t hash, const struct chip8 *c8);
+
+/* Print the registers and framebuffer of a finished test. */
+static void dump(const struct test_case *test, const struct chip8 *c8);
+
+int main(int argc, char *argv[])
+{
+    static char lines[MAX_LINES][512];
+    static struct test_case tests[MAX_TESTS];
+    struct job_queue queue = { .tests = tests, .verbose = false };
+    bool update = false;
+    int threads = SDL_GetCPUCount();
+    const char *manifest = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-u") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            queue.verbose = true;
+        }
+        else
+        {
+            manifest = argv[i];
+        }
+    }
+
+    if (manifest == NULL)
+    {
+        fprintf(stderr, "Usage: %s [-j threads] [-u] [-v] <manifest>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int line_count = 0;
+    queue.count = read_manifest(manifest, lines, &line_count, tests);
+    if (queue.count < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    SDL_AtomicSet(&queue.next, 0);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    threads = threads < 1 ? 1 : threads > queue.count ? queue.count : threads;
+    SDL_Thread *pool[64];
+    threads = threads > 64 ? 64 : threads;
+    for (int t = 1; t < threads; t++)
+    {
+        pool[t] = SDL_CreateThread(worker, "c8_test", &queue);
+    }
+    worker(&queue);
+    for (int t = 1; t < threads; t++)
+    {
+        SDL_WaitThread(pool[t], NULL);
+    }
+    const double ELAPSED_MS = (SDL_GetPerformanceCounter() - start) * 1000.0 /
+        SDL_GetPerformanceFrequency();
+
+    int passed = 0;
+    for (int i = 0; i < queue.count; i++)
+    {
+        struct test_case *test = &tests[i];
+        if (!test->ran)
+        {
+            printf("FAIL %-16s could not be run\n", test->name);
+        }
+        else if (test->actual != test->expected)
+        {
+            printf("FAIL %-16s expected %016llx, got %016llx\n", test->name,
+                    (unsigned long long)test->expected, (unsigned long long)test->actual);
+        }
+        else
+        {
+            printf("pass %s\n", test->name);
+            passed++;
+        }
+
+        if (update && test->ran)
+        {
+            char hex[HASH_DIGITS + 1];
+            snprintf(hex, sizeof hex, "%016llx", (unsigned long long)test->actual);
+            memcpy(&lines[test->line][test->hash_offset], hex, HASH_DIGITS);
+        }
+    }
+    printf("%d/%d passed in %.1f ms\n", passed, queue.count, ELAPSED_MS);
+
+    if (update)
+    {
+        FILE *out = fopen(manifest, "w");
+        if (out == NULL)
+        {
+            perror(manifest);
+            return EXIT_FAILURE;
+        }
+        for (int i = 0; i < line_count; i++)
+        {
+            fputs(lines[i], out);
+        }
+        fclose(out);
+        printf("Updated %s\n", manifest);
+        return EXIT_SUCCESS;
+    }
+    return passed == queue.count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int read_manifest(const char *path, char lines[][512], int *line_count, struct test_case *tests)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    /* Rom paths are relative to the directory holding the manifest. */
+    const char *slash = strrchr(path, '/');
+    const int DIR_LEN = slash != NULL ? slash - path + 1 : 0;
+
+    int count = 0;
+    bool ok = true;
+    while (ok && *line_count < MAX_LINES && fgets(lines[*line_count], sizeof lines[0], in) != NULL)
+    {
+        const int LINE = (*line_count)++;
+        const char *text = lines[LINE];
+        while (isspace((unsigned char)*text))
+        {
+            text++;
+        }
+        if (*text == '\0' || *text == '#')
+        {
+            continue;
+        }
+        if (count == MAX_TESTS)
+        {
+            fprintf(stderr, "%s:%d: too many tests\n", path, LINE + 1);
+            ok = false;
+            break;
+        }
+
+        struct test_case *test = &tests[count];
+        char rom[256], mode[16], timing[16], input[256], hash[HASH_DIGITS + 8];
+        int hash_start = 0;
+        if (sscanf(text, "%31s %255s %15s %15s %u %u %255s %n%23s", test->name, rom, mode, timing,
+                    &test->frames, &test->every, input, &hash_start, hash) != 8 ||
+                strlen(hash) != HASH_DIGITS)
+        {
+            fprintf(stderr, "%s:%d: expected 'name rom mode timing frames every input hash'\n",
+                    path, LINE + 1);
+            ok = false;
+            break;
+        }
+
+        test->mode = strcmp(mode, "xochip") == 0 ? C8_MODE_XOCHIP :
+            strcmp(mode, "schip") == 0 ? C8_MODE_SCHIP : C8_MODE_CHIP8;
+        test->timing = strcmp(timing, "vip") == 0 ? C8_TIMING_VIP : C8_TIMING_FIXED;
+        if ((test->mode == C8_MODE_CHIP8 && strcmp(mode, "chip8") != 0) ||
+                (test->timing == C8_TIMING_FIXED && strcmp(timing, "fixed") != 0))
+        {
+            fprintf(stderr, "%s:%d: unknown mode '%s' or timing '%s'\n", path, LINE + 1, mode, timing);
+            ok = false;
+            break;
+        }
+        if (!parse_input(input, test))
+        {
+            fprintf(stderr, "%s:%d: invalid input script '%s'\n", path, LINE + 1, input);
+            ok = false;
+            break;
+        }
+
+        snprintf(test->rom, sizeof test->rom, "%.*s%s", DIR_LEN, path, rom);
+        test->expected = strtoull(hash, NULL, 16);
+        test->line = LINE;
+        test->hash_offset = (text - lines[LINE]) + hash_start;
+        while (isspace((unsigned char)lines[LINE][test->hash_offset]))
+        {
+            test->hash_offset++;
+        }
+        test->ran = false;
+        count++;
+    }
+
+    fclose(in);
+    if (ok && count == 0)
+    {
+        fprintf(stderr, "%s: no tests\n", path);
+        ok = false;
+    }
+    return ok ? count : -1;
+}
+
+static bool parse_input(const char *script, struct test_case *test)
+{
+    test->event_count = 0;
+    test->shared = strncmp(script, "shm:", 4) == 0;
+    if (strcmp(script, "-") == 0)
+    {
+        return true;
+    }
+    if (test->shared)
+    {
+        script += 4;
+    }
+
+    const char *p = script;
+    while (*p != '\0')
+    {
+        unsigned int frame, key;
+        char sign;
+        int len = 0;
+        if (test->event_count == MAX_EVENTS ||
+                sscanf(p, "%u:%c%x%n", &frame, &sign, &key, &len) != 3 ||
+                (sign != '+' && sign != '-') || key > 0xF)
+        {
+            return false;
+        }
+        test->events[test->event_count++] = (struct key_event){ frame, key, sign == '+' };
+        p += len;
+        if (*p == ',')
+        {
+            p++;
+        }
+        else if (*p != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool load_rom(struct chip8 *c8, const char *path)
+{
+    const size_t LEN = strlen(path);
+    if (LEN < 4 || strcmp(path + LEN - 4, ".hex") != 0)
+    {
+        return c8_load((char *)path, c8, C8_LOAD_ADDR) >= 0;
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[512];
+    int number = 0;
+    size_t addr = C8_LOAD_ADDR;
+    bool ok = true;
+    while (ok && fgets(line, sizeof line, in) != NULL)
+    {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        /* Tokenised by hand, as strtok is not safe to use from several workers. */
+        char *token = line;
+        while (ok && *(token += strspn(token, " \t\r\n")) != '\0')
+        {
+            const size_t TOKEN_LEN = strcspn(token, " \t\r\n");
+            char *next = token + TOKEN_LEN;
+            if (*next != '\0')
+            {
+                *next++ = '\0';
+            }
+            char *end;
+            if (token[TOKEN_LEN - 1] == ':')
+            {
+                const unsigned long LABEL = strtoul(token, &end, 16);
+                ok = end == token + TOKEN_LEN - 1 && LABEL >= addr;
+                addr = LABEL;
+                token = next;
+                continue;
+            }
+
+            ok = TOKEN_LEN % 2 == 0 && TOKEN_LEN <= 8 && addr + TOKEN_LEN / 2 <= c8->mem_size;
+            const unsigned long VALUE = ok ? strtoul(token, &end, 16) : 0;
+            ok = ok && end == token + TOKEN_LEN;
+            for (int byte = TOKEN_LEN / 2 - 1; ok && byte >= 0; byte--)
+            {
+                c8->memory[addr++] = VALUE >> (8 * byte);
+            }
+            token = next;
+        }
+    }
+
+    if (!ok)
+    {
+        fprintf(stderr, "%s:%d: invalid token or address\n", path, number);
+    }
+    fclose(in);
+    return ok;
+}
+
+static int worker(void *data)
+{
+    struct job_queue *queue = data;
+    int index;
+    while ((index = SDL_AtomicAdd(&queue->next, 1)) < queue->count)
+    {
+        run(&queue->tests[index], queue->verbose);
+    }
+    return 0;
+}
+
+static void run(struct test_case *test, bool verbose)
+{
+    struct chip8 *c8 = malloc(sizeof *c8);
+    struct c8_cpu *cpu = malloc(sizeof *cpu);
+    if (c8 == NULL || cpu == NULL || !c8_init(c8, cpu) || !c8_set_mode(c8, test->mode) ||
+            !load_rom(c8, test->rom))
+    {
+        fprintf(stderr, "%s: failed to load '%s'\n", test->name, test->rom);
+        free(cpu);
+        free(c8);
+        return;
+    }
+
+    /* Named per test, as tests run concurrently. */
+    struct c8_shared shared;
+    if (test->shared)
+    {
+        char name[64];
+        snprintf(name, sizeof name, "/c8_test_%s", test->name);
+        if (!shared_open(&shared, name))
+        {
+            free(cpu);
+            free(c8);
+            return;
+        }
+        c8->shared = &shared;
+    }
+
+    /*
+     * Step the CPU directly in 60 Hz frames with scripted input applied at each frame's start.
+     * Under VIP timing this matches the run loop's batches. Under fixed timing the run loop
+     * batches single instructions and samples input before each, so here a frame is C8_FPS / 60
+     * instructions instead. The run loop itself, with its watch reloads, run-ahead and AOT
+     * dispatch, is not exercised.
+     */
+    const Uint32 BUDGET = test->timing == C8_TIMING_VIP ? C8_VIP_FRAME_CYCLES : C8_FPS / 60;
+    uint64_t hash = FNV_OFFSET;
+    bool ok = true;
+    c8->timing = test->timing;
+    c8->cpu->pc = C8_LOAD_ADDR;
+    c8->alive = true;
+    for (uint32_t frame = 0; ok && c8->alive && frame < test->frames; frame++)
+    {
+        if (c8->shared != NULL)
+        {
+            shared_input(c8->shared, c8);
+        }
+        bool written = false;
+        for (int i = 0; i < test->event_count; i++)
+        {
+            if (test->events[i].frame != frame)
+            {
+                continue;
+            }
+            if (c8->shared != NULL)
+            {
+                c8->shared->segment->keys[test->events[i].key] = test->events[i].down;
+                written = true;
+            }
+            else
+            {
+                c8->keyboard[test->events[i].key] = test->events[i].down;
+            }
+        }
+        if (written)
+        {
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicAdd(&c8->shared->segment->key_sequence, 1);
+        }
+
+        while (c8->alive && c8->cpu->cycles < BUDGET)
+        {
+            /*
+             * FX0A would wait on SDL input, so a key must already be held by the script, or be
+             * written to shared memory for the wait to apply.
+             */
+            const uint16_t OP = c8_mem_read16(c8, c8->cpu->pc);
+            bool held = c8->shared != NULL &&
+                SDL_AtomicGet(&c8->shared->segment->key_sequence) != c8->shared->key_sequence;
+            for (int key = 0; key < 16; key++)
+            {
+                held |= c8->keyboard[key];
+            }
+            if ((OP & 0xF0FF) == 0xF00A && !held)
+            {
+                fprintf(stderr, "%s: FX0A at %#05x with no key held\n", test->name, c8->cpu->pc);
+                ok = false;
+                break;
+            }
+            if (!cpu_step(c8))
+            {
+                fprintf(stderr, "%s: CPU exception at frame %u\n", test->name, frame);
+                ok = false;
+                break;
+            }
+        }
+        c8->cpu->cycles -= c8->cpu->cycles < BUDGET ? c8->cpu->cycles : BUDGET;
+        if (test->timing == C8_TIMING_VIP)
+        {
+            cpu_decrement_timers(c8);
+        }
+
+        if (test->every > 0 && (frame + 1) % test->every == 0)
+        {
+            hash = hash_display(hash, &c8->display);
+        }
+    }
+
+    if (ok)
+    {
+        test->actual = hash_state(hash, c8);
+        test->ran = true;
+    }
+    if (verbose)
+    {
+        dump(test, c8);
+    }
+
+    /* Release the XO-CHIP address space, c8_destroy would also tear down SDL. */
+    if (c8->shared != NULL)
+    {
+        shared_close(c8->shared);
+    }
+    c8_set_mode(c8, C8_MODE_CHIP8);
+    free(cpu);
+    free(c8);
+}
+
+static uint64_t hash_bytes(uint64_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t hash_word(uint64_t hash, uint64_t value, int bytes)
+{
+    for (int byte = bytes - 1; byte >= 0; byte--)
+    {
+        hash = (hash ^ (uint8_t)(value >> (8 * byte))) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t hash_display(uint64_t hash, const struct c8_display *display)
+{
+    for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+    {
+        for (int y = 0; y < C8_HIRES_HEIGHT; y++)
+        {
+            for (int word = 0; word < C8_ROW_WORDS; word++)
+            {
+                hash = hash_word(hash, display->rows[plane][y][word], 8);
+            }
+        }
+    }
+    hash = hash_word(hash, display->hires, 1);
+    return hash_word(hash, display->planes, 1);
+}
+
+static uint64_t hash_state(uint64_t hash, const struct chip8 *c8)
+{
+    const struct c8_cpu *cpu = c8->cpu;
+    hash = hash_bytes(hash, cpu->v, sizeof cpu->v);
+    hash = hash_word(hash, cpu->i, 2);
+    hash = hash_word(hash, cpu->pc, 2);
+    hash = hash_word(hash, cpu->sp, 1);
+    for (int i = 0; i < 0x10; i++)
+    {
+        hash = hash_word(hash, cpu->stack[i], 2);
+    }
+    hash = hash_bytes(hash, cpu->rpl, sizeof cpu->rpl);
+    hash = hash_word(hash, cpu->timer_delay, 1);
+    hash = hash_word(hash, cpu->timer_sound, 1);
+    hash = hash_bytes(hash, c8->memory, c8->mem_size);
+    hash = hash_bytes(hash, c8->audio_pattern, sizeof c8->audio_pattern);
+    hash = hash_word(hash, c8->pitch, 1);
+    return hash_display(hash, &c8->display);
+}
+
+static void dump(const struct test_case *test, const struct chip8 *c8)
+{
+    /* Format into one buffer so the output of concurrent tests is not interleaved. */
+    static const char COLOURS[] = ".#+@";
+    char *out = malloc(C8_HIRES_HEIGHT * (C8_HIRES_WIDTH + 1) + 512);
+    if (out == NULL)
+    {
+        return;
+    }
+    const struct c8_cpu *cpu = c8->cpu;
+    int len = sprintf(out, "== %s: PC %#05x I %#05x SP %d DT %d ST %d\n  ", test->name, cpu->pc,
+            cpu->i, cpu->sp, cpu->timer_delay, cpu->timer_sound);
+    for (int i = 0; i <= 0xF; i++)
+    {
+        len += sprintf(out + len, "v%X=%02x%s", i, cpu->v[i], i == 7 ? "\n  " : " ");
+    }
+    out[len++] = '\n';
+
+    const int WIDTH = display_width(&c8->display);
+    const int HEIGHT = display_height(&c8->display);
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            out[len++] = COLOURS[display_pixel(&c8->display, x, y)];
+        }
+        out[len++] = '\n';
+    }
+    fwrite(out, 1, len, stdout);
+    free(out);
+}
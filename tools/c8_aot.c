@@ -0,0 +1,575 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+
+/*
+ * Recompile a ROM ahead of time into a C translation unit, which links against the core library
+ * into a standalone binary with the ROM built in ('make aot ROM=<rom>' does both steps).
+ *
+ * Every basic block reachable from the load address becomes a function operating directly on the
+ * chip8 and its CPU, with the same semantics and cycle costs as cpu_step for the selected mode.
+ * Instructions with no cheaper expansion, such as scrolls and XO-CHIP plane or audio selection,
+ * are handed to cpu_step in place. At runtime anything not compiled here is interpreted instead:
+ * targets of BNNN that static tracing cannot follow, and blocks invalidated by self-modifying code.
+ */
+
+/* Write the generated source for a traced program. */
+static void emit_program(FILE *out, const struct c8_program *program, const char *rom,
+        enum c8_timing timing);
+
+/* Write the function for a single block. */
+static void emit_block(FILE *out, const struct c8_program *program, const struct c8_block *block);
+
+/*
+ * Write the statements for the instruction at addr, charging its cycles and ticking the timers as
+ * cpu_step does. remaining is the number of instructions following it in the block, which are
+ * uncounted if it returns early. Return true if it sets the pc itself, ending the block.
+ */
+static bool emit_ins(FILE *out, const struct c8_program *program, uint32_t addr, uint16_t op,
+        uint32_t next, int remaining);
+
+/* Write a single statement, indented into the body of a block. */
+static void emit(FILE *out, const char *format, ...);
+
+/* Read a word of the program, 0 past the end of memory. */
+static uint16_t read16(const struct c8_program *program, uint32_t addr);
+
+int main(int argc, char *argv[])
+{
+    static const size_t MAX_ROM = C8_XO_MEM_SIZE;
+    enum c8_mode mode = C8_MODE_CHIP8;
+    enum c8_timing timing = C8_TIMING_FIXED;
+    const char *output = NULL;
+    const char *rom = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "chip8") != 0 && strcmp(argv[i], "schip") != 0 &&
+                    strcmp(argv[i], "xochip") != 0)
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            mode = strcmp(argv[i], "xochip") == 0 ? C8_MODE_XOCHIP :
+                strcmp(argv[i], "schip") == 0 ? C8_MODE_SCHIP : C8_MODE_CHIP8;
+        }
+        else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "fixed") != 0 && strcmp(argv[i], "vip") != 0)
+            {
+                fprintf(stderr, "Unknown timing '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            timing = strcmp(argv[i], "vip") == 0 ? C8_TIMING_VIP : C8_TIMING_FIXED;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            rom = argv[i];
+        }
+    }
+
+    if (rom == NULL)
+    {
+        fprintf(stderr, "Usage: %s [--mode chip8|schip|xochip] [--timing fixed|vip] [-o <file.c>] <rom>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *in = fopen(rom, "rb");
+    if (in == NULL)
+    {
+        perror(rom);
+        return EXIT_FAILURE;
+    }
+    uint8_t *image = malloc(MAX_ROM);
+    struct c8_program *program = malloc(sizeof *program);
+    bool ok = image != NULL && program != NULL;
+    size_t len = ok ? fread(image, 1, MAX_ROM, in) : 0;
+    fclose(in);
+
+    if (!ok || !disasm_load(program, image, len, mode) || !disasm_trace(program))
+    {
+        fprintf(stderr, "Failed to analyse '%s'\n", rom);
+        free(program);
+        free(image);
+        return EXIT_FAILURE;
+    }
+    if (program->block_count == 0)
+    {
+        /* Nothing to compile, and an empty block table would not be valid C. */
+        fprintf(stderr, "No reachable code in '%s'\n", rom);
+        disasm_free(program);
+        free(program);
+        free(image);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = output != NULL ? fopen(output, "w") : stdout;
+    if (out == NULL)
+    {
+        perror(output);
+        ok = false;
+    }
+    else
+    {
+        emit_program(out, program, rom, timing);
+        ok = out == stdout || fclose(out) == 0;
+    }
+
+    disasm_free(program);
+    free(program);
+    free(image);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void emit_program(FILE *out, const struct c8_program *program, const char *rom,
+        enum c8_timing timing)
+{
+    static const char *MODES[] = { "C8_MODE_CHIP8", "C8_MODE_SCHIP", "C8_MODE_XOCHIP" };
+    fprintf(out,
+            "/* Generated by c8_aot from %s, do not edit. */\n"
+            "#include <assert.h>\n"
+            "#include <stdio.h>\n"
+            "#include <stdlib.h>\n"
+            "#include <string.h>\n"
+            "\n"
+            "#include \"aot.h\"\n"
+            "#include \"chip8.h\"\n"
+            "#include \"cpu.h\"\n"
+            "\n"
+            "/* Charge an instruction to the frame before it runs, and tick fixed timers after it. */\n"
+            "#define CLOCK(op)   if (c8->timing == C8_TIMING_VIP) { cpu_clock(c8, op); } else { cpu->cycles++; }\n"
+            "#define TIMERS()    if (c8->timing == C8_TIMING_FIXED) { cpu_decrement_timers(c8); }\n"
+            "\n"
+            "static const uint8_t ROM[] =\n{",
+            rom);
+    for (uint32_t addr = C8_LOAD_ADDR; addr < program->end; addr++)
+    {
+        fprintf(out, "%s0x%02x,", (addr - C8_LOAD_ADDR) % 16 == 0 ? "\n    " : " ",
+                program->memory[addr]);
+    }
+    fprintf(out, "\n};\n");
+
+    for (size_t b = 0; b < program->block_count; b++)
+    {
+        emit_block(out, program, &program->blocks[b]);
+    }
+
+    fprintf(out, "\nstatic const struct c8_aot_block BLOCKS[] =\n{\n");
+    for (size_t b = 0; b < program->block_count; b++)
+    {
+        const struct c8_block *block = &program->blocks[b];
+        fprintf(out, "    { 0x%04x, 0x%04x, block_%04x },\n", block->start, block->end, block->start);
+    }
+    fprintf(out, "};\n");
+
+    fprintf(out,
+            "\n"
+            "static struct chip8 c8;\n"
+            "static struct c8_cpu cpu;\n"
+            "static struct c8_aot aot;\n"
+            "\n"
+            "int main(int argc, char *argv[])\n"
+            "{\n"
+            "    if (!c8_init(&c8, &cpu) || !c8_set_mode(&c8, %s))\n"
+            "    {\n"
+            "        fprintf(stderr, \"Failed to init CHIP-8 system\\n\");\n"
+            "        return EXIT_FAILURE;\n"
+            "    }\n"
+            "    c8.timing = %s;\n"
+            "    if (argc > 2 && strcmp(argv[1], \"--timing\") == 0)\n"
+            "    {\n"
+            "        c8.timing = strcmp(argv[2], \"vip\") == 0 ? C8_TIMING_VIP : C8_TIMING_FIXED;\n"
+            "    }\n"
+            "    memcpy(&c8.memory[C8_LOAD_ADDR], ROM, sizeof ROM);\n"
+            "    aot_init(&aot, BLOCKS, sizeof BLOCKS / sizeof BLOCKS[0]);\n"
+            "    c8.aot = &aot;\n"
+            "\n"
+            "    if (!c8_open(&c8))\n"
+            "    {\n"
+            "        fprintf(stderr, \"Failed to open CHIP-8 window\\n\");\n"
+            "        return EXIT_FAILURE;\n"
+            "    }\n"
+            "    return c8_run(&c8, C8_LOAD_ADDR) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;\n"
+            "}\n",
+            MODES[program->mode], timing == C8_TIMING_VIP ? "C8_TIMING_VIP" : "C8_TIMING_FIXED");
+}
+
+static void emit_block(FILE *out, const struct c8_program *program, const struct c8_block *block)
+{
+    int count = 0;
+    struct c8_ins ins;
+    for (uint32_t addr = block->start; addr < block->end; addr += ins.len)
+    {
+        disasm_decode(read16(program, addr), read16(program, addr + 2), program->mode, &ins);
+        count++;
+    }
+
+    fprintf(out, "\nstatic bool block_%04x(struct chip8 *c8)\n{\n", block->start);
+    fprintf(out, "    struct c8_cpu *cpu = c8->cpu;\n");
+    fprintf(out, "    c8->metrics.instructions += %d;\n", count);
+
+    char text[32];
+    int remaining = count;
+    for (uint32_t addr = block->start; addr < block->end; addr += ins.len)
+    {
+        const uint16_t OP = read16(program, addr);
+        const uint16_t FOLLOWING = read16(program, addr + 2);
+        disasm_decode(OP, FOLLOWING, program->mode, &ins);
+        disasm_format(OP, FOLLOWING, program->mode, text, sizeof text);
+        fprintf(out, "\n    /* %04x: %s */\n", addr, text);
+
+        const uint32_t NEXT = (addr + ins.len) & 0xFFFF;
+        remaining--;
+        if (emit_ins(out, program, addr, OP, NEXT, remaining))
+        {
+            break;
+        }
+        if (remaining == 0)
+        {
+            emit(out, "cpu->pc = 0x%04x;", NEXT);
+            emit(out, "return true;");
+        }
+    }
+    fprintf(out, "}\n");
+}
+
+static bool emit_ins(FILE *out, const struct c8_program *program, uint32_t addr, uint16_t op,
+        uint32_t next, int remaining)
+{
+    const unsigned X   = (op & 0x0F00) >> 8;
+    const unsigned Y   = (op & 0x00F0) >> 4;
+    const unsigned N   = (op & 0x000F) >> 0;
+    const unsigned NN  = (op & 0x00FF) >> 0;
+    const unsigned NNN = (op & 0x0FFF) >> 0;
+    const bool SCHIP = program->mode == C8_MODE_SCHIP;
+    const bool XOCHIP = program->mode == C8_MODE_XOCHIP;
+    const bool EXTENDED = program->mode != C8_MODE_CHIP8;
+
+    /* XO-CHIP skips step over the whole of a following 4 byte 0xF000 NNNN. */
+    const uint32_t SKIP = (next + (XOCHIP && read16(program, next) == 0xF000 ? 4 : 2)) & 0xFFFF;
+    bool sets_pc = false;
+    bool writes = false;
+    bool slow = false;
+    char cond[64] = "";
+
+    /* Classify first, so instructions left to the interpreter skip the clock and timer macros. */
+    bool interpret = false;
+    switch (op & 0xF000)
+    {
+        case 0x0000:
+            interpret = EXTENDED && X == 0 && ((op & 0xF0) == 0xC0 ||
+                    ((op & 0xF0) == 0xD0 && XOCHIP) || NN >= 0xFB);
+            break;
+        case 0x5000:
+            interpret = XOCHIP && (N == 0x2 || N == 0x3);
+            writes = interpret;
+            break;
+        case 0x8000:
+            interpret = N > 0x7 && N != 0xE;
+            break;
+        case 0xE000:
+            interpret = NN != 0x9E && NN != 0xA1;
+            break;
+        case 0xF000:
+            switch (NN)
+            {
+                case 0x07:
+                case 0x0A:
+                case 0x15:
+                case 0x18:
+                case 0x1E:
+                case 0x29:
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                    break;
+                case 0x30:
+                case 0x75:
+                case 0x85:
+                    interpret = !EXTENDED;
+                    break;
+                default:
+                    interpret = true;
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (interpret)
+    {
+        emit(out, "cpu->pc = 0x%04x;", addr);
+        emit(out, "if (!cpu_step(c8))");
+        emit(out, "{");
+        emit(out, "    return false;");
+        emit(out, "}");
+    }
+    else
+    {
+        emit(out, "CLOCK(0x%04x);", op);
+        switch (op & 0xF000)
+        {
+            case 0x0000:
+                if (NN == 0xE0)
+                {
+                    emit(out, "display_clear(&c8->display);");
+                    emit(out, "c8->draw = true;");
+                    slow = true;
+                }
+                else if (NN == 0xEE)
+                {
+                    emit(out, "assert(cpu->sp > 0);");
+                    emit(out, "cpu->pc = cpu->stack[--cpu->sp];");
+                    sets_pc = true;
+                }
+                else
+                {
+                    emit(out, "assert(cpu->sp < 0x10);");
+                    emit(out, "cpu->stack[cpu->sp++] = 0x%04x;", next);
+                    emit(out, "cpu->pc = 0x%03x;", NNN);
+                    sets_pc = true;
+                }
+                break;
+            case 0x1000:
+                emit(out, "cpu->pc = 0x%03x;", NNN);
+                sets_pc = true;
+                break;
+            case 0x2000:
+                emit(out, "assert(cpu->sp < 0x10);");
+                emit(out, "cpu->stack[cpu->sp++] = 0x%04x;", next);
+                emit(out, "cpu->pc = 0x%03x;", NNN);
+                sets_pc = true;
+                break;
+            case 0x3000:
+                snprintf(cond, sizeof cond, "cpu->v[0x%X] == 0x%02x", X, NN);
+                break;
+            case 0x4000:
+                snprintf(cond, sizeof cond, "cpu->v[0x%X] != 0x%02x", X, NN);
+                break;
+            case 0x5000:
+                snprintf(cond, sizeof cond, "cpu->v[0x%X] == cpu->v[0x%X]", X, Y);
+                break;
+            case 0x6000:
+                emit(out, "cpu->v[0x%X] = 0x%02x;", X, NN);
+                break;
+            case 0x7000:
+                emit(out, "cpu->v[0x%X] += 0x%02x;", X, NN);
+                break;
+            case 0x8000:
+            {
+                /* SUPER-CHIP shifts vx in place and ignores vy. */
+                const unsigned SHIFTED = SCHIP ? X : Y;
+                switch (N)
+                {
+                    case 0x0:
+                        emit(out, "cpu->v[0x%X] = cpu->v[0x%X];", X, Y);
+                        break;
+                    case 0x1:
+                        emit(out, "cpu->v[0x%X] |= cpu->v[0x%X];", X, Y);
+                        break;
+                    case 0x2:
+                        emit(out, "cpu->v[0x%X] &= cpu->v[0x%X];", X, Y);
+                        break;
+                    case 0x3:
+                        emit(out, "cpu->v[0x%X] ^= cpu->v[0x%X];", X, Y);
+                        break;
+                    case 0x4:
+                        emit(out, "{");
+                        emit(out, "    const uint16_t SUM = cpu->v[0x%X] + cpu->v[0x%X];", X, Y);
+                        emit(out, "    cpu->v[0x%X] = SUM;", X);
+                        emit(out, "    cpu->v[0xF] = SUM > 0xFF;");
+                        emit(out, "}");
+                        break;
+                    case 0x5:
+                    case 0x7:
+                    {
+                        const unsigned FROM = N == 0x5 ? X : Y;
+                        const unsigned BY = N == 0x5 ? Y : X;
+                        emit(out, "{");
+                        emit(out, "    const bool BORROW = cpu->v[0x%X] > cpu->v[0x%X];", BY, FROM);
+                        emit(out, "    cpu->v[0x%X] = cpu->v[0x%X] - cpu->v[0x%X];", X, FROM, BY);
+                        emit(out, "    cpu->v[0xF] = !BORROW;");
+                        emit(out, "}");
+                        break;
+                    }
+                    default:
+                    {
+                        /* Plain CHIP-8 writes vf before vx, as cpu_step does. */
+                        const bool RIGHT = N == 0x6;
+                        emit(out, "{");
+                        emit(out, "    const uint8_t SRC = cpu->v[0x%X];", SHIFTED);
+                        if (!EXTENDED)
+                        {
+                            emit(out, "    cpu->v[0xF] = SRC %s;", RIGHT ? "& 1" : ">> 7");
+                        }
+                        emit(out, "    cpu->v[0x%X] = SRC %s 1;", X, RIGHT ? ">>" : "<<");
+                        if (EXTENDED)
+                        {
+                            emit(out, "    cpu->v[0xF] = SRC %s;", RIGHT ? "& 1" : ">> 7");
+                        }
+                        emit(out, "}");
+                        break;
+                    }
+                }
+                break;
+            }
+            case 0x9000:
+                snprintf(cond, sizeof cond, "cpu->v[0x%X] != cpu->v[0x%X]", X, Y);
+                break;
+            case 0xA000:
+                emit(out, "cpu->i = 0x%03x;", NNN);
+                break;
+            case 0xB000:
+                /* The one jump static tracing cannot follow, the dispatcher interprets unknown targets. */
+                emit(out, "cpu->pc = 0x%03x + cpu->v[0x%X];", NNN, SCHIP ? X : 0);
+                sets_pc = true;
+                break;
+            case 0xC000:
+                emit(out, "cpu->v[0x%X] = cpu_random(cpu) & 0x%02x;", X, NN);
+                break;
+            case 0xD000:
+                emit(out, "cpu_draw_sprite(c8, cpu->v[0x%X], cpu->v[0x%X], %u);", X, Y, N);
+                slow = true;
+                break;
+            case 0xE000:
+                snprintf(cond, sizeof cond, "%sc8_key_pressed(c8, cpu->v[0x%X])", NN == 0x9E ? "" : "!", X);
+                break;
+            default:
+                switch (NN)
+                {
+                    case 0x07:
+                        emit(out, "cpu->v[0x%X] = cpu->timer_delay;", X);
+                        break;
+                    case 0x0A:
+                        /* An abandoned wait leaves the block on FX0A, to be executed again. */
+                        emit(out, "{");
+                        emit(out, "    const uint8_t KEY = c8_key_await(c8);");
+                        emit(out, "    if (KEY == C8_KEY_NONE)");
+                        emit(out, "    {");
+                        emit(out, "        TIMERS();");
+                        if (remaining > 0)
+                        {
+                            emit(out, "        c8->metrics.instructions -= %d;", remaining);
+                        }
+                        emit(out, "        cpu->pc = 0x%04x;", addr);
+                        emit(out, "        return true;");
+                        emit(out, "    }");
+                        emit(out, "    cpu->v[0x%X] = KEY;", X);
+                        emit(out, "}");
+                        break;
+                    case 0x15:
+                        emit(out, "cpu->timer_delay = cpu->v[0x%X];", X);
+                        break;
+                    case 0x18:
+                        emit(out, "cpu->timer_sound = cpu->v[0x%X];", X);
+                        break;
+                    case 0x1E:
+                        emit(out, "cpu->i += cpu->v[0x%X];", X);
+                        break;
+                    case 0x29:
+                        emit(out, "cpu->i = cpu->v[0x%X] * C8_SPRITE_LEN;", X);
+                        break;
+                    case 0x30:
+                        emit(out, "cpu->i = C8_BIG_FONT_ADDR + (cpu->v[0x%X] & 0xF) * C8_BIG_SPRITE_LEN;", X);
+                        break;
+                    case 0x33:
+                        emit(out, "c8_mem_write8(c8, cpu->i, cpu->v[0x%X] / 100);", X);
+                        emit(out, "c8_mem_write8(c8, cpu->i + 1, (cpu->v[0x%X] / 10) %% 10);", X);
+                        emit(out, "c8_mem_write8(c8, cpu->i + 2, cpu->v[0x%X] %% 10);", X);
+                        writes = true;
+                        break;
+                    case 0x55:
+                        for (unsigned r = 0; r <= X; r++)
+                        {
+                            emit(out, "c8_mem_write8(c8, cpu->i + %u, cpu->v[0x%X]);", r, r);
+                        }
+                        if (!SCHIP)
+                        {
+                            emit(out, "cpu->i += %u;", X + 1);
+                        }
+                        writes = true;
+                        break;
+                    case 0x65:
+                        for (unsigned r = 0; r <= X; r++)
+                        {
+                            emit(out, "cpu->v[0x%X] = c8_mem_read8(c8, cpu->i + %u);", r, r);
+                        }
+                        if (!SCHIP)
+                        {
+                            emit(out, "cpu->i += %u;", X + 1);
+                        }
+                        break;
+                    case 0x75:
+                        emit(out, "memcpy(cpu->rpl, cpu->v, %u);", X + 1);
+                        break;
+                    default:
+                        emit(out, "memcpy(cpu->v, cpu->rpl, %u);", X + 1);
+                        break;
+                }
+                break;
+        }
+        if (cond[0] != '\0')
+        {
+            emit(out, "cpu->pc = %s ? 0x%04x : 0x%04x;", cond, SKIP, next);
+            sets_pc = true;
+        }
+        emit(out, "TIMERS();");
+    }
+
+    if (sets_pc)
+    {
+        if (remaining > 0)
+        {
+            emit(out, "c8->metrics.instructions -= %d;", remaining);
+        }
+        emit(out, "return true;");
+        return true;
+    }
+
+    /*
+     * Stop at once if this overwrote compiled code. Under VIP timing blocks otherwise run to the end
+     * once the frame budget is spent, but a clear or draw alone can spend a frame.
+     */
+    if ((writes || slow) && remaining > 0)
+    {
+        emit(out, writes ? "if (c8->aot->stale)" :
+                "if (c8->timing == C8_TIMING_VIP && cpu->cycles >= C8_VIP_FRAME_CYCLES)");
+        emit(out, "{");
+        emit(out, "    c8->metrics.instructions -= %d;", remaining);
+        emit(out, "    cpu->pc = 0x%04x;", next);
+        emit(out, "    return true;");
+        emit(out, "}");
+    }
+    return false;
+}
+
+static void emit(FILE *out, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    fprintf(out, "    ");
+    vfprintf(out, format, args);
+    fprintf(out, "\n");
+    va_end(args);
+}
+
+static uint16_t read16(const struct c8_program *program, uint32_t addr)
+{
+    if (addr + 1 >= C8_XO_MEM_SIZE)
+    {
+        return 0;
+    }
+    return ((uint16_t)program->memory[addr] << 8) | program->memory[addr + 1];
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+/*
+ * Convert a gameplay capture stream into images for downstream tools. Frames are rendered at
+ * 128x64, with lores frames doubled in both directions, using the same palette as the emulator.
+ *
+ *  --png <dir>   write one PNG per recorded frame, named by emulated frame number
+ *  --raw <file>  write headerless RGB24 video with one image per emulated frame, repeating
+ *                unchanged frames, suitable for e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s 128x64
+ */
+
+#define IMAGE_WIDTH     C8_HIRES_WIDTH
+#define IMAGE_HEIGHT    C8_HIRES_HEIGHT
+
+static const uint8_t PALETTE[4][3] =
+{
+    { 0x00, 0x00, 0x00 },
+    { 0x00, 0xFF, 0x00 },
+    { 0xFF, 0x00, 0xFF },
+    { 0xFF, 0xFF, 0xFF }
+};
+
+/* Render a captured frame to RGB24. */
+static void render(const struct c8_capture_frame *frame, uint8_t *rgb);
+
+/* Write an RGB24 image as an uncompressed PNG. */
+static bool write_png(const char *filename, const uint8_t *rgb);
+
+/* PNG checksum helpers. */
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len);
+static void put_u32(uint8_t *out, uint32_t value);
+static void write_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len);
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4 || (strcmp(argv[2], "--png") != 0 && strcmp(argv[2], "--raw") != 0))
+    {
+        fprintf(stderr, "Usage: %s <capture> --png <dir> | --raw <file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const bool PNG = strcmp(argv[2], "--png") == 0;
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        perror("Failed to open capture");
+        return EXIT_FAILURE;
+    }
+    if (!capture_read_header(in))
+    {
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    FILE *raw = NULL;
+    if (!PNG)
+    {
+        raw = fopen(argv[3], "wb");
+        if (raw == NULL)
+        {
+            perror("Failed to open output");
+            fclose(in);
+            return EXIT_FAILURE;
+        }
+    }
+
+    static struct c8_capture_frame frame;
+    static uint8_t rgb[IMAGE_WIDTH * IMAGE_HEIGHT * 3];
+    bool first = true;
+    uint32_t previous = 0;
+    size_t count = 0;
+    int status = EXIT_SUCCESS;
+    int read;
+    while ((read = capture_read_frame(in, &frame)) > 0)
+    {
+        if (PNG)
+        {
+            char filename[4096];
+            render(&frame, rgb);
+            snprintf(filename, sizeof filename, "%s/frame_%08u.png", argv[3], frame.frame);
+            if (!write_png(filename, rgb))
+            {
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+        else
+        {
+            /* Hold the previous image for every emulated frame up to this one. */
+            bool written = true;
+            for (uint32_t n = previous + 1; written && !first && n < frame.frame; n++)
+            {
+                written = fwrite(rgb, 1, sizeof rgb, raw) == sizeof rgb;
+            }
+            render(&frame, rgb);
+            if (!written || fwrite(rgb, 1, sizeof rgb, raw) != sizeof rgb)
+            {
+                perror("Failed to write output");
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+        first = false;
+        previous = frame.frame;
+        count++;
+    }
+    if (read < 0)
+    {
+        status = EXIT_FAILURE;
+    }
+
+    if (raw != NULL && fclose(raw) != 0)
+    {
+        perror("Failed to write output");
+        status = EXIT_FAILURE;
+    }
+    fclose(in);
+    printf("Converted %zu frames\n", count);
+    return status;
+}
+
+static void render(const struct c8_capture_frame *frame, uint8_t *rgb)
+{
+    const int SHIFT = (frame->flags & C8_CAPTURE_HIRES) ? 0 : 1;
+    for (int y = 0; y < IMAGE_HEIGHT; y++)
+    {
+        for (int x = 0; x < IMAGE_WIDTH; x++)
+        {
+            const int PX = x >> SHIFT;
+            const uint64_t MASK = (uint64_t)1 << (63 - (PX & 63));
+            int colour = 0;
+            for (int plane = 0; plane < C8_DISPLAY_PLANES; plane++)
+            {
+                if (frame->rows[plane][y >> SHIFT][PX >> 6] & MASK)
+                {
+                    colour |= 1 << plane;
+                }
+            }
+            memcpy(&rgb[(y * IMAGE_WIDTH + x) * 3], PALETTE[colour], 3);
+        }
+    }
+}
+
+static bool write_png(const char *filename, const uint8_t *rgb)
+{
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL)
+    {
+        perror("Failed to open PNG");
+        return false;
+    }
+
+    static const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(SIGNATURE, 1, sizeof SIGNATURE, f);
+
+    /* 8-bit RGB, no interlacing. */
+    uint8_t ihdr[13] = { 0 };
+    put_u32(&ihdr[0], IMAGE_WIDTH);
+    put_u32(&ihdr[4], IMAGE_HEIGHT);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    write_chunk(f, "IHDR", ihdr, sizeof ihdr);
+
+    /* A zlib stream holding a single stored deflate block of filter-type-0 scanlines. */
+    enum { STRIDE = IMAGE_WIDTH * 3 + 1, RAW_LEN = STRIDE * IMAGE_HEIGHT };
+    static uint8_t idat[2 + 5 + RAW_LEN + 4];
+    uint8_t *raw = &idat[7];
+    idat[0] = 0x78;
+    idat[1] = 0x01;
+    idat[2] = 0x01;
+    idat[3] = RAW_LEN & 0xFF;
+    idat[4] = RAW_LEN >> 8;
+    idat[5] = ~RAW_LEN & 0xFF;
+    idat[6] = (~RAW_LEN >> 8) & 0xFF;
+    for (int y = 0; y < IMAGE_HEIGHT; y++)
+    {
+        raw[y * STRIDE] = 0;
+        memcpy(&raw[y * STRIDE + 1], &rgb[y * IMAGE_WIDTH * 3], IMAGE_WIDTH * 3);
+    }
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (int i = 0; i < RAW_LEN; i++)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(&idat[7 + RAW_LEN], (b << 16) | a);
+    write_chunk(f, "IDAT", idat, sizeof idat);
+    write_chunk(f, "IEND", NULL, 0);
+
+    /* Chunks are written unchecked, a failure sticks to the stream until it is closed. */
+    const bool WRITTEN = !ferror(f);
+    if (fclose(f) != 0 || !WRITTEN)
+    {
+        perror("Failed to write PNG");
+        return false;
+    }
+    return true;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void write_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len)
+{
+    uint8_t word[4];
+    put_u32(word, len);
+    fwrite(word, 1, 4, f);
+    fwrite(type, 1, 4, f);
+    if (len > 0)
+    {
+        fwrite(data, 1, len, f);
+    }
+
+    uint32_t crc = crc32(0, (const uint8_t *)type, 4);
+    put_u32(word, crc32(crc, data, len));
+    fwrite(word, 1, 4, f);
+}
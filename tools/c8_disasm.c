@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "disasm.h"
+
+/*
+ * Statically disassemble ROMs, without running them.
+ *
+ * With a single ROM the listing (or with --dot, the control flow graph) is written to stdout. With
+ * several ROMs each one is written alongside its input as <rom>.asm or <rom>.dot, and the ROMs are
+ * shared between a pool of worker threads, one per CPU unless -j is given.
+ */
+
+struct job_queue
+{
+    char **roms;
+    int count;
+    SDL_atomic_t next;
+    SDL_atomic_t failures;
+    enum c8_mode mode;
+    bool dot;
+    bool to_stdout;
+};
+
+/* Worker thread entry point, processes ROMs until the queue is exhausted. */
+static int worker(void *data);
+
+/* Disassemble a single ROM, return true on success. */
+static bool process(struct job_queue *queue, const char *rom);
+
+int main(int argc, char *argv[])
+{
+    struct job_queue queue = { .mode = C8_MODE_CHIP8, .dot = false };
+    int threads = SDL_GetCPUCount();
+    int first_rom = argc;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "chip8") != 0 && strcmp(argv[i], "schip") != 0 &&
+                    strcmp(argv[i], "xochip") != 0)
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            queue.mode = strcmp(argv[i], "xochip") == 0 ? C8_MODE_XOCHIP :
+                strcmp(argv[i], "schip") == 0 ? C8_MODE_SCHIP : C8_MODE_CHIP8;
+        }
+        else if (strcmp(argv[i], "--dot") == 0)
+        {
+            queue.dot = true;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else
+        {
+            first_rom = i;
+            break;
+        }
+    }
+
+    if (first_rom >= argc)
+    {
+        fprintf(stderr, "Usage: %s [--mode chip8|schip|xochip] [--dot] [-j threads] <rom>...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    queue.roms = &argv[first_rom];
+    queue.count = argc - first_rom;
+    queue.to_stdout = queue.count == 1;
+    SDL_AtomicSet(&queue.next, 0);
+    SDL_AtomicSet(&queue.failures, 0);
+
+    threads = threads < 1 ? 1 : threads > queue.count ? queue.count : threads;
+    SDL_Thread *pool[64];
+    threads = threads > 64 ? 64 : threads;
+    for (int t = 1; t < threads; t++)
+    {
+        pool[t] = SDL_CreateThread(worker, "c8_disasm", &queue);
+    }
+    worker(&queue);
+    for (int t = 1; t < threads; t++)
+    {
+        SDL_WaitThread(pool[t], NULL);
+    }
+
+    return SDL_AtomicGet(&queue.failures) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int worker(void *data)
+{
+    struct job_queue *queue = data;
+    int index;
+    while ((index = SDL_AtomicAdd(&queue->next, 1)) < queue->count)
+    {
+        if (!process(queue, queue->roms[index]))
+        {
+            SDL_AtomicAdd(&queue->failures, 1);
+        }
+    }
+    return 0;
+}
+
+static bool process(struct job_queue *queue, const char *rom)
+{
+    static const size_t MAX_ROM = C8_XO_MEM_SIZE;
+    FILE *in = fopen(rom, "rb");
+    if (in == NULL)
+    {
+        perror(rom);
+        return false;
+    }
+    uint8_t *image = malloc(MAX_ROM);
+    struct c8_program *program = malloc(sizeof *program);
+    bool ok = image != NULL && program != NULL;
+    size_t len = ok ? fread(image, 1, MAX_ROM, in) : 0;
+    fclose(in);
+
+    ok = ok && disasm_load(program, image, len, queue->mode) && disasm_trace(program);
+    if (ok)
+    {
+        FILE *out = stdout;
+        if (!queue->to_stdout)
+        {
+            char filename[4096];
+            snprintf(filename, sizeof filename, "%s.%s", rom, queue->dot ? "dot" : "asm");
+            out = fopen(filename, "w");
+            if (out == NULL)
+            {
+                perror(filename);
+                ok = false;
+            }
+        }
+        if (out != NULL)
+        {
+            if (queue->dot)
+            {
+                disasm_print_dot(program, out);
+            }
+            else
+            {
+                fprintf(out, "; %s: %zu bytes, %zu blocks\n", rom, len, program->block_count);
+                disasm_print(program, out);
+            }
+            if (out != stdout)
+            {
+                fclose(out);
+            }
+        }
+        disasm_free(program);
+    }
+    else
+    {
+        fprintf(stderr, "Failed to disassemble '%s'\n", rom);
+    }
+
+    free(program);
+    free(image);
+    return ok;
+}